@@ -0,0 +1,356 @@
+// Headless benchmarks for the map core. Runs against SDL's dummy video
+// driver with a software renderer, so it needs no display:
+//
+//   make bench
+//   ./bench.exe --nodes 1000,10000 --shapes wide,deep,dag --out bench.json
+//
+// Each (shape, size) gets a freshly generated map; results are written as
+// JSON so runs from different builds can be diffed.
+
+#include "../glyphatlas.h"
+#include "../labelcache.h"
+#include "../map.h"
+#include "../node.h"
+#include "../textlayout.h"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Result {
+  std::string name;
+  std::string shape;
+  size_t nodes;
+  int iterations;
+  double totalMs;
+  double minMs;
+  double maxMs;
+};
+
+struct Options {
+  std::vector<size_t> sizes = {1000, 10000};
+  std::vector<std::string> shapes = {"wide", "deep", "dag"};
+  std::string font = "res/mainFont.ttf";
+  std::string out = "bench.json";
+  int repeat = 5;
+  int width = 1280;
+  int height = 720;
+  unsigned seed = 1;
+};
+
+static const int fanout = 8;
+static const float spacing = 160;
+
+static std::vector<Result> results;
+
+static std::vector<std::string> split(const std::string &list) {
+  std::vector<std::string> parts;
+  std::stringstream ss(list);
+  std::string part;
+  while (std::getline(ss, part, ','))
+    if (!part.empty())
+      parts.push_back(part);
+  return parts;
+}
+
+static bool parseArgs(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      std::cout << "Missing value for " << arg << '\n';
+      return false;
+    }
+    std::string value = argv[++i];
+
+    if (arg == "--nodes") {
+      options.sizes.clear();
+      for (const std::string &size : split(value))
+        options.sizes.push_back(std::stoul(size));
+    } else if (arg == "--shapes") {
+      options.shapes = split(value);
+    } else if (arg == "--font") {
+      options.font = value;
+    } else if (arg == "--out") {
+      options.out = value;
+    } else if (arg == "--repeat") {
+      options.repeat = std::max(1, std::stoi(value));
+    } else if (arg == "--seed") {
+      options.seed = static_cast<unsigned>(std::stoul(value));
+    } else {
+      std::cout << "Unknown option " << arg << '\n';
+      return false;
+    }
+  }
+  return true;
+}
+
+static void measure(const std::string &name, const std::string &shape,
+                    size_t nodes, int iterations,
+                    const std::function<void()> &fn) {
+  Result result{name, shape, nodes, iterations, 0, 1e300, 0};
+  for (int i = 0; i < iterations; i++) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    result.totalMs += ms;
+    result.minMs = std::min(result.minMs, ms);
+    result.maxMs = std::max(result.maxMs, ms);
+  }
+
+  std::printf("%-14s %-5s %8zu  mean %10.3f ms  min %10.3f ms\n",
+              name.c_str(), shape.c_str(), nodes,
+              result.totalMs / iterations, result.minMs);
+  results.push_back(result);
+}
+
+static std::string label(std::mt19937 &rng) {
+  static const char *words[] = {"plan",  "idea",    "note",   "draft",
+                                "task",  "review",  "launch", "budget",
+                                "risk",  "meeting", "design", "research",
+                                "goal",  "summary", "follow", "question"};
+  int count = 1 + rng() % 6;
+  std::string text;
+  for (int i = 0; i < count; i++) {
+    if (i)
+      text += ' ';
+    text += words[rng() % 16];
+  }
+  return text;
+}
+
+// Builds a map of roughly `count` nodes in one of the shapes:
+//   wide  breadth-first tree, `fanout` children per node
+//   deep  a single chain, folded into rows so it stays on screen
+//   dag   nodes on a grid, each with one to three earlier parents
+static std::vector<Node *> generate(const std::string &shape, size_t count,
+                                    TTF_Font *font, std::mt19937 &rng) {
+  std::vector<Node *> nodes;
+  nodes.reserve(count);
+
+  if (shape == "wide") {
+    // Rows are spread so each parent sits above the middle of its
+    // children, as in a hand-drawn tree; only the last row may be partial.
+    std::vector<size_t> depth;
+    std::vector<size_t> rowStart = {0};
+    for (size_t i = 0; i < count; i++) {
+      size_t d = i == 0 ? 0 : depth[(i - 1) / fanout] + 1;
+      if (d >= rowStart.size())
+        rowStart.push_back(i);
+      depth.push_back(d);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      size_t d = depth[i];
+      float slot = spacing * std::pow(fanout, rowStart.size() - 1 - d);
+      float x = (i - rowStart[d] + 0.5f) * slot;
+      Node *node = Node::create(x, d * spacing * 2, font);
+      if (i > 0)
+        node->addParent(nodes[(i - 1) / fanout]);
+      nodes.push_back(node);
+    }
+  } else if (shape == "deep") {
+    size_t row = std::max<size_t>(1, std::sqrt(count));
+    for (size_t i = 0; i < count; i++) {
+      size_t r = i / row;
+      size_t c = r % 2 ? row - 1 - i % row : i % row;
+      Node *node = Node::create(c * spacing, r * spacing, font);
+      if (i > 0)
+        node->addParent(nodes[i - 1]);
+      nodes.push_back(node);
+    }
+  } else {
+    size_t row = std::max<size_t>(1, std::sqrt(count));
+    for (size_t i = 0; i < count; i++) {
+      Node *node = Node::create((i % row) * spacing, (i / row) * spacing,
+                                font);
+      // Parents come from the last few rows so edges stay fairly local.
+      size_t window = std::min(i, row * 3);
+      int parents = i > 0 ? 1 + rng() % 3 : 0;
+      for (int p = 0; p < parents; p++)
+        node->addParent(nodes[i - 1 - rng() % window]);
+      nodes.push_back(node);
+    }
+  }
+
+  for (Node *node : nodes)
+    node->setText(label(rng));
+  return nodes;
+}
+
+// Centres the view on the middle node in creation order, which lands in a
+// populated part of every shape.
+static void centreOn(Map &map, const std::vector<Node *> &nodes, float zoom,
+                     const Options &options) {
+  const Node *middle = nodes[nodes.size() / 2];
+  map.dx = options.width / zoom / 2 - middle->getX();
+  map.dy = options.height / zoom / 2 - middle->getY();
+}
+
+static void run(const std::string &shape, size_t count, TTF_Font *font,
+                SDL_Renderer *renderer, const Options &options) {
+  std::mt19937 rng(options.seed);
+  Map map;
+  Map::curMap = &map;
+
+  std::vector<Node *> nodes;
+  measure("generate", shape, count, 1,
+          [&] { nodes = generate(shape, count, font, rng); });
+
+  auto frame = [&](float zoom) {
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    SDL_RenderClear(renderer);
+    map.render(renderer, zoom, options.width, options.height);
+    SDL_RenderPresent(renderer);
+  };
+
+  // The first frame builds labels and fills the glyph atlas.
+  centreOn(map, nodes, 1, options);
+  measure("render-cold", shape, count, 1, [&] { frame(1); });
+  // Frames until every label on screen has its glyphs from the workers.
+  measure("render-fill", shape, count, 1, [&] {
+    while (GlyphAtlas::isLoading())
+      frame(1);
+  });
+  measure("render", shape, count, options.repeat, [&] { frame(1); });
+  centreOn(map, nodes, 0.05f, options);
+  measure("render-far", shape, count, options.repeat, [&] { frame(0.05f); });
+
+  std::vector<std::string> labels;
+  for (Node *node : nodes)
+    labels.push_back(node->getText());
+  FontMetrics *metrics = FontMetrics::get(font);
+  measure("text-layout", shape, count, options.repeat, [&] {
+    TextLayout layout;
+    for (const std::string &text : labels)
+      layout.reset(metrics, text);
+  });
+
+  std::vector<std::pair<float, float>> points;
+  for (int i = 0; i < 100000; i++) {
+    Node *node = nodes[rng() % nodes.size()];
+    float jitter = node->getRadius();
+    points.push_back({node->getX() + jitter * ((rng() % 200) / 100.0f - 1),
+                      node->getY() + jitter * ((rng() % 200) / 100.0f - 1)});
+  }
+  measure("hit-test-100k", shape, count, options.repeat, [&] {
+    for (const auto &[x, y] : points)
+      map.index.queryPoint(x, y);
+  });
+
+  // Moves the root's whole subtree, or for a chain everything below the
+  // middle.
+  Node *moved = shape == "deep" ? nodes[nodes.size() / 2] : nodes[0];
+  float step = spacing;
+  measure("move-subtree", shape, count, options.repeat, [&] {
+    moved->setXRec(moved->getX() + step);
+    step = -step;
+  });
+
+  std::string path = "bench-" + shape + "-" + std::to_string(count) + ".mind";
+  measure("save", shape, count, options.repeat,
+          [&] { map.saveMap(path); });
+  measure("load", shape, count, options.repeat, [&] {
+    float dx, dy;
+    map.loadMap(path, font, &dx, &dy);
+  });
+  std::remove(path.c_str());
+
+  // Loading replaced every node, so look them up again.
+  nodes.clear();
+  map.nodes.forEach([&](Node *node) { nodes.push_back(node); });
+  std::shuffle(nodes.begin(), nodes.end(), rng);
+  size_t victims = std::max<size_t>(1, nodes.size() / 10);
+  measure("destruct-10pct", shape, count, 1, [&] {
+    for (size_t i = 0; i < victims; i++)
+      nodes[i]->destruct();
+  });
+
+  Map::curMap = nullptr;
+}
+
+static void writeResults(const Options &options) {
+  std::ofstream out(options.out);
+  if (!out) {
+    std::cout << "Failed to open " << options.out << '\n';
+    return;
+  }
+
+  out << "{\n  \"results\": [\n";
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result &r = results[i];
+    out << "    {\"name\": \"" << r.name << "\", \"shape\": \"" << r.shape
+        << "\", \"nodes\": " << r.nodes << ", \"iterations\": "
+        << r.iterations << ", \"mean_ms\": " << r.totalMs / r.iterations
+        << ", \"min_ms\": " << r.minMs << ", \"max_ms\": " << r.maxMs << "}"
+        << (i + 1 < results.size() ? "," : "") << '\n';
+  }
+  out << "  ]\n}\n";
+  std::cout << "Wrote " << results.size() << " results to " << options.out
+            << '\n';
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseArgs(argc, argv, options))
+    return 1;
+
+  // Left alone if the caller already picked a driver.
+  SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+  if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+    std::cout << "SDL_Init failed: " << SDL_GetError() << '\n';
+    return 1;
+  }
+  if (TTF_Init() < 0) {
+    std::cout << "TTF_Init failed: " << TTF_GetError() << '\n';
+    return 1;
+  }
+
+  SDL_Surface *target = SDL_CreateRGBSurfaceWithFormat(
+      0, options.width, options.height, 32, SDL_PIXELFORMAT_ARGB8888);
+  SDL_Renderer *renderer = target ? SDL_CreateSoftwareRenderer(target) : nullptr;
+  if (!renderer) {
+    std::cout << "SDL_CreateSoftwareRenderer failed: " << SDL_GetError()
+              << '\n';
+    return 1;
+  }
+  SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+
+  TTF_Font *font = TTF_OpenFont(options.font.c_str(), 18);
+  if (!font) {
+    std::cout << "TTF_OpenFont failed: " << TTF_GetError() << '\n';
+    return 1;
+  }
+  GlyphAtlas::setFontFile(font, options.font, 18);
+
+  for (const std::string &shape : options.shapes) {
+    if (shape != "wide" && shape != "deep" && shape != "dag") {
+      std::cout << "Unknown shape " << shape << '\n';
+      continue;
+    }
+    for (size_t size : options.sizes)
+      run(shape, size, font, renderer, options);
+  }
+
+  writeResults(options);
+
+  GlyphAtlas::destroyAll();
+  LabelCache::clear();
+  TTF_CloseFont(font);
+  SDL_DestroyRenderer(renderer);
+  SDL_FreeSurface(target);
+  TTF_Quit();
+  SDL_Quit();
+  return 0;
+}
@@ -0,0 +1,82 @@
+#include "blobbatch.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Sides of the polygon drawn for each blob; at a few pixels across an
+// octagon is indistinguishable from a circle.
+static constexpr int blobSides = 8;
+
+void BlobBatch::begin(float cellSize) {
+  this->blobs.clear();
+  this->cells.clear();
+  this->cellSize = cellSize;
+}
+
+void BlobBatch::add(float x, float y, float radius, SDL_Color color) {
+  int64_t cx = static_cast<int64_t>(std::floor(x / this->cellSize));
+  int64_t cy = static_cast<int64_t>(std::floor(y / this->cellSize));
+  uint64_t key = (uint64_t(uint32_t(cx)) << 32) | uint32_t(cy);
+
+  auto [it, inserted] =
+      this->cells.try_emplace(key, static_cast<int>(this->blobs.size()));
+  if (inserted)
+    this->blobs.emplace_back();
+  Blob &blob = this->blobs[it->second];
+
+  // Weighted by area so one big node isn't washed out by specks.
+  float area = radius * radius;
+  blob.x += x * area;
+  blob.y += y * area;
+  blob.r += color.r * area;
+  blob.g += color.g * area;
+  blob.b += color.b * area;
+  blob.area += area;
+}
+
+void BlobBatch::flush(SDL_Renderer *renderer) {
+  if (this->blobs.empty())
+    return;
+
+  this->vertices.clear();
+  this->indices.clear();
+
+  float unitX[blobSides];
+  float unitY[blobSides];
+  for (int i = 0; i < blobSides; i++) {
+    float angle = 2 * static_cast<float>(M_PI) * i / blobSides;
+    unitX[i] = std::cos(angle);
+    unitY[i] = std::sin(angle);
+  }
+
+  for (const Blob &blob : this->blobs) {
+    if (blob.area <= 0)
+      continue;
+
+    float x = blob.x / blob.area;
+    float y = blob.y / blob.area;
+    // Same total area as its nodes, but never spilling far past its cell
+    // and never thinner than a pixel.
+    float radius = std::clamp(std::sqrt(blob.area), 1.0f, this->cellSize);
+    SDL_Color color = {static_cast<Uint8>(blob.r / blob.area),
+                       static_cast<Uint8>(blob.g / blob.area),
+                       static_cast<Uint8>(blob.b / blob.area), 255};
+
+    int centre = static_cast<int>(this->vertices.size());
+    this->vertices.push_back({{x, y}, color, {0, 0}});
+    for (int i = 0; i < blobSides; i++)
+      this->vertices.push_back(
+          {{x + unitX[i] * radius, y + unitY[i] * radius}, color, {0, 0}});
+    for (int i = 0; i < blobSides; i++)
+      this->indices.insert(this->indices.end(),
+                           {centre, centre + 1 + i,
+                            centre + 1 + (i + 1) % blobSides});
+  }
+
+  if (SDL_RenderGeometry(renderer, nullptr, this->vertices.data(),
+                         static_cast<int>(this->vertices.size()),
+                         this->indices.data(),
+                         static_cast<int>(this->indices.size())) != 0) {
+    std::cout << "SDL_RenderGeometry failed: " << SDL_GetError() << '\n';
+  }
+}
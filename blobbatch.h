@@ -0,0 +1,41 @@
+#ifndef BLOBBATCH_H
+#define BLOBBATCH_H
+
+#include <SDL2/SDL.h>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Low-detail stand-ins for nodes too small on screen to be worth a circle
+// and a label. Nodes are binned into a screen-space grid; every occupied
+// cell becomes one flat blob with the nodes' average colour and their
+// combined area, so a dense region costs one shape however many nodes it
+// holds. Everything is submitted with a single SDL_RenderGeometry call, in
+// screen space, so the renderer scale must be 1 when flushing.
+class BlobBatch {
+public:
+  void begin(float cellSize);
+  // Screen-space centre and radius.
+  void add(float x, float y, float radius, SDL_Color color);
+  void flush(SDL_Renderer *renderer);
+
+private:
+  struct Blob {
+    float x = 0;
+    float y = 0;
+    float area = 0;
+    float r = 0;
+    float g = 0;
+    float b = 0;
+  };
+
+  std::vector<Blob> blobs;
+  std::unordered_map<uint64_t, int> cells;
+
+  std::vector<SDL_Vertex> vertices;
+  std::vector<int> indices;
+
+  float cellSize = 1;
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include "circlebatch.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Segment counts come in steps of segmentStep, enough that the polygon
+// strays from the true circle by at most maxError screen pixels.
+static constexpr int segmentStep = 8;
+static constexpr int minSegments = 16;
+static constexpr int maxSegments = 128;
+static constexpr float maxError = 0.25f;
+
+void CircleBatch::begin(float zoom) {
+  this->vertices.clear();
+  this->indices.clear();
+  this->zoom = zoom;
+  this->pixel = 1 / zoom;
+}
+
+const CircleBatch::Unit &CircleBatch::unit(float radius) {
+  float screen = std::max(radius * this->zoom, 1.0f);
+  float step = 2 * std::acos(std::max(0.0f, 1 - maxError / screen));
+  int segments = step > 0 ? static_cast<int>(std::ceil(2 * M_PI / step))
+                          : maxSegments;
+  segments = std::clamp((segments + segmentStep - 1) / segmentStep *
+                            segmentStep,
+                        minSegments, maxSegments);
+
+  size_t bucket = segments / segmentStep;
+  if (bucket >= this->units.size())
+    this->units.resize(bucket + 1);
+
+  Unit &unit = this->units[bucket];
+  if (unit.x.empty()) {
+    for (int i = 0; i < segments; i++) {
+      double angle = 2 * M_PI * i / segments;
+      unit.x.push_back(static_cast<float>(std::cos(angle)));
+      unit.y.push_back(static_cast<float>(std::sin(angle)));
+    }
+  }
+  return unit;
+}
+
+int CircleBatch::addCircle(float x, float y, const Unit &unit, float radius,
+                           SDL_Color color) {
+  int first = static_cast<int>(this->vertices.size());
+  radius = std::max(radius, 0.0f);
+  for (size_t i = 0; i < unit.x.size(); i++)
+    this->vertices.push_back(
+        {{x + unit.x[i] * radius, y + unit.y[i] * radius}, color, {0, 0}});
+  return first;
+}
+
+void CircleBatch::addBand(float x, float y, const Unit &unit, float inner,
+                          SDL_Color innerColor, float outer,
+                          SDL_Color outerColor) {
+  int n = static_cast<int>(unit.x.size());
+  int a = this->addCircle(x, y, unit, inner, innerColor);
+  int b = this->addCircle(x, y, unit, outer, outerColor);
+  for (int i = 0; i < n; i++) {
+    int j = (i + 1) % n;
+    this->indices.insert(this->indices.end(),
+                         {a + i, b + i, b + j, a + i, b + j, a + j});
+  }
+}
+
+void CircleBatch::addDisc(float x, float y, float radius, SDL_Color color) {
+  const Unit &unit = this->unit(radius);
+  int n = static_cast<int>(unit.x.size());
+  float half = this->pixel / 2;
+  SDL_Color clear = {color.r, color.g, color.b, 0};
+
+  int centre = static_cast<int>(this->vertices.size());
+  this->vertices.push_back({{x, y}, color, {0, 0}});
+  int rim = this->addCircle(x, y, unit, radius - half, color);
+  for (int i = 0; i < n; i++)
+    this->indices.insert(this->indices.end(),
+                         {centre, rim + i, rim + (i + 1) % n});
+
+  this->addBand(x, y, unit, radius - half, color, radius + half, clear);
+}
+
+void CircleBatch::addRing(float x, float y, float radius, float width,
+                          SDL_Color color) {
+  const Unit &unit = this->unit(radius);
+  float half = width * this->pixel / 2;
+  float feather = this->pixel / 2;
+  SDL_Color clear = {color.r, color.g, color.b, 0};
+
+  // Solid core with a feathered edge either side; rings thinner than the
+  // feather collapse to a fainter peak at the radius.
+  float innerSolid = radius - half + feather;
+  float outerSolid = radius + half - feather;
+  SDL_Color core = color;
+  if (innerSolid > outerSolid) {
+    innerSolid = outerSolid = radius;
+    core.a = static_cast<Uint8>(color.a * std::min(1.0f, width));
+  }
+
+  this->addBand(x, y, unit, radius - half - feather, clear, innerSolid, core);
+  if (outerSolid > innerSolid)
+    this->addBand(x, y, unit, innerSolid, core, outerSolid, core);
+  this->addBand(x, y, unit, outerSolid, core, radius + half + feather, clear);
+}
+
+void CircleBatch::flush(SDL_Renderer *renderer) {
+  if (this->indices.empty())
+    return;
+
+  if (SDL_RenderGeometry(renderer, nullptr, this->vertices.data(),
+                         static_cast<int>(this->vertices.size()),
+                         this->indices.data(),
+                         static_cast<int>(this->indices.size())) != 0) {
+    std::cout << "SDL_RenderGeometry failed: " << SDL_GetError() << '\n';
+  }
+}
@@ -0,0 +1,43 @@
+#ifndef CIRCLEBATCH_H
+#define CIRCLEBATCH_H
+
+#include <SDL2/SDL.h>
+#include <vector>
+
+// Node bodies, outlines and selection halos as triangle fans in one vertex
+// buffer, submitted with a single SDL_RenderGeometry call in the order they
+// were added, so overlapping nodes still stack. Edges get a one screen pixel
+// alpha skirt for anti-aliasing, and segment counts follow the on-screen
+// radius. Coordinates are in the renderer's current scale; zoom only sets
+// how wide a screen pixel is.
+class CircleBatch {
+public:
+  void begin(float zoom);
+  void addDisc(float x, float y, float radius, SDL_Color color);
+  // A ring `width` screen pixels wide centred on radius.
+  void addRing(float x, float y, float radius, float width, SDL_Color color);
+  void flush(SDL_Renderer *renderer);
+
+private:
+  struct Unit {
+    std::vector<float> x;
+    std::vector<float> y;
+  };
+
+  const Unit &unit(float radius);
+  void addBand(float x, float y, const Unit &unit, float inner,
+               SDL_Color innerColor, float outer, SDL_Color outerColor);
+  int addCircle(float x, float y, const Unit &unit, float radius,
+                SDL_Color color);
+
+  std::vector<SDL_Vertex> vertices;
+  std::vector<int> indices;
+
+  // Unit circles, one per segment count bucket.
+  std::vector<Unit> units;
+
+  float zoom = 1;
+  float pixel = 1;
+};
+
+#endif
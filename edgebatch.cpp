@@ -0,0 +1,95 @@
+#include "edgebatch.h"
+#include "node.h"
+#include <cmath>
+#include <iostream>
+
+static constexpr SDL_Color edgeColor = {0, 0, 0, 255};
+static constexpr float arrowLength = 20;
+static constexpr float arrowHalfWidth = 10;
+static constexpr float lineHalfWidth = 0.5f;
+
+// Arrowheads smaller than this on screen can't be read and are skipped, as
+// are shafts shorter than this.
+static constexpr float minArrowPixels = 6;
+static constexpr float minLinePixels = 1;
+
+void EdgeBatch::begin(float dx, float dy, float zoom) {
+  this->vertices.clear();
+  this->indices.clear();
+
+  this->dx = dx;
+  this->dy = dy;
+  this->zoom = zoom;
+}
+
+void EdgeBatch::addLine(float x1, float y1, float x2, float y2) {
+  float lx = x2 - x1;
+  float ly = y2 - y1;
+  float len = std::sqrt(lx * lx + ly * ly);
+  if (len < 1e-3f)
+    return;
+
+  float ox = -ly / len * lineHalfWidth;
+  float oy = lx / len * lineHalfWidth;
+
+  int base = static_cast<int>(this->vertices.size());
+
+  this->vertices.push_back({{x1 + ox, y1 + oy}, edgeColor, {0, 0}});
+  this->vertices.push_back({{x1 - ox, y1 - oy}, edgeColor, {0, 0}});
+  this->vertices.push_back({{x2 - ox, y2 - oy}, edgeColor, {0, 0}});
+  this->vertices.push_back({{x2 + ox, y2 + oy}, edgeColor, {0, 0}});
+
+  this->indices.insert(this->indices.end(), {base, base + 1, base + 2, base,
+                                             base + 2, base + 3});
+}
+
+void EdgeBatch::addEdge(const Node *from, const Node *to) {
+  float px = from->getX();
+  float py = from->getY();
+  float cx = to->getX();
+  float cy = to->getY();
+
+  auto sx = [this](float x) { return (x + this->dx) * this->zoom; };
+  auto sy = [this](float y) { return (y + this->dy) * this->zoom; };
+
+  float x1 = sx(px), y1 = sy(py), x2 = sx(cx), y2 = sy(cy);
+  if (std::fabs(x2 - x1) + std::fabs(y2 - y1) < minLinePixels)
+    return;
+  this->addLine(x1, y1, x2, y2);
+
+  if (arrowLength * this->zoom < minArrowPixels)
+    return;
+
+  float ux = cx - px;
+  float uy = cy - py;
+  float d = std::sqrt(ux * ux + uy * uy);
+  if (d < 1e-3f)
+    return;
+
+  ux /= d;
+  uy /= d;
+
+  // Tip sits on the child's rim; the wings are offset back along the edge
+  // and out along its normal (-uy, ux).
+  float tipX = cx - ux * to->getRadius();
+  float tipY = cy - uy * to->getRadius();
+  float baseX = tipX - ux * arrowLength;
+  float baseY = tipY - uy * arrowLength;
+
+  this->addLine(sx(tipX), sy(tipY), sx(baseX + uy * arrowHalfWidth),
+                sy(baseY - ux * arrowHalfWidth));
+  this->addLine(sx(tipX), sy(tipY), sx(baseX - uy * arrowHalfWidth),
+                sy(baseY + ux * arrowHalfWidth));
+}
+
+void EdgeBatch::flush(SDL_Renderer *renderer) {
+  if (this->indices.empty())
+    return;
+
+  if (SDL_RenderGeometry(renderer, nullptr, this->vertices.data(),
+                         static_cast<int>(this->vertices.size()),
+                         this->indices.data(),
+                         static_cast<int>(this->indices.size())) != 0) {
+    std::cout << "SDL_RenderGeometry failed: " << SDL_GetError() << '\n';
+  }
+}
@@ -0,0 +1,30 @@
+#ifndef EDGEBATCH_H
+#define EDGEBATCH_H
+
+#include <SDL2/SDL.h>
+#include <vector>
+
+class Node;
+
+// Collects every visible edge shaft and arrowhead into one vertex buffer and
+// submits it with a single SDL_RenderGeometry call. Lines are emitted as
+// thin quads in screen space, so the renderer scale must be 1 when flushing.
+// Zoomed far enough out, arrowheads and sub-pixel shafts are left out.
+class EdgeBatch {
+public:
+  void begin(float dx, float dy, float zoom);
+  void addEdge(const Node *from, const Node *to);
+  void flush(SDL_Renderer *renderer);
+
+private:
+  void addLine(float x1, float y1, float x2, float y2);
+
+  std::vector<SDL_Vertex> vertices;
+  std::vector<int> indices;
+
+  float dx = 0;
+  float dy = 0;
+  float zoom = 1;
+};
+
+#endif
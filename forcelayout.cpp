@@ -0,0 +1,325 @@
+#include "forcelayout.h"
+#include "map.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+// Barnes-Hut opening criterion: a cell whose width over distance is below
+// this acts as one body.
+static constexpr float theta = 0.8f;
+
+static constexpr float repulsion = 3e6f;
+// Extra push between individual nodes whose rims come within edgeGap / 2,
+// which long-range repulsion alone is too soft to prevent.
+static constexpr float collision = 100;
+static constexpr float springStrength = 4;
+static constexpr float gravity = 0.05f;
+
+// Gap springs try to leave between the rims of connected nodes.
+static constexpr float edgeGap = 80;
+
+// A node of this radius has unit mass, so big nodes push harder.
+static constexpr float massRadius = 40;
+
+// Closer than this, repulsion stops growing; cells this small stop
+// splitting so stacked nodes can't recurse forever.
+static constexpr float minDistance = 10;
+static constexpr float minHalf = 1;
+
+// Below this many bodies a step isn't worth spreading across threads.
+static constexpr size_t bodiesPerThread = 512;
+
+ForceLayout::ForceLayout() {
+  // The thread calling step works too.
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned i = 1; i < threads; i++)
+    this->workers.emplace_back(&ForceLayout::run, this);
+}
+
+ForceLayout::~ForceLayout() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = 1;
+  }
+  this->wake.notify_all();
+  for (std::thread &worker : this->workers)
+    worker.join();
+}
+
+void ForceLayout::step(Map &map, float dt, NodeId held) {
+  this->nodes = &map.nodes;
+  this->bodies.clear();
+  this->maxRadius = 0;
+  map.nodes.forEach([&](Node *node) {
+    float mass = std::max(node->radius / massRadius, 0.25f);
+    this->bodies.push_back({node, node->x, node->y, node->radius, mass});
+    this->maxRadius = std::max(this->maxRadius, node->radius);
+
+    uint32_t index = node->id.index;
+    if (index >= this->starts.size())
+      this->starts.resize(index + 1);
+    Start &start = this->starts[index];
+    if (!start.seen || start.generation != node->id.generation)
+      start = {node->id.generation, node->x, node->y, 1};
+  });
+
+  if (this->bodies.empty())
+    return;
+
+  this->buildTree();
+  const Cell &root = this->cells[0];
+  float cx = root.mx / root.mass;
+  float cy = root.my / root.mass;
+
+  size_t chunks = std::max<size_t>(
+      1, std::min(this->workers.size() + 1,
+                  this->bodies.size() / bodiesPerThread));
+  if (chunks == 1) {
+    this->accumulate(0, this->bodies.size(), cx, cy);
+  } else {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->chunks = chunks;
+    this->chunkSize = (this->bodies.size() + chunks - 1) / chunks;
+    this->nextChunk = 0;
+    this->remaining = chunks;
+    this->centerX = cx;
+    this->centerY = cy;
+    this->wake.notify_all();
+
+    this->drain(lock);
+    this->done.wait(lock, [this] { return this->remaining == 0; });
+  }
+
+  for (const Body &body : this->bodies) {
+    Node *node = body.node;
+    if (node->id == held) {
+      node->vx = node->vy = node->fx = node->fy = 0;
+      continue;
+    }
+
+    node->tick(dt);
+    if (node->x != body.x || node->y != body.y)
+      node->reindex();
+  }
+}
+
+void ForceLayout::finish(Map &map) {
+  map.nodes.forEach([&](Node *node) {
+    node->vx = node->vy = node->fx = node->fy = 0;
+
+    uint32_t index = node->id.index;
+    if (index >= this->starts.size())
+      return;
+    const Start &start = this->starts[index];
+    if (start.seen && start.generation == node->id.generation &&
+        (start.x != node->x || start.y != node->y))
+      node->recordMove(start.x, start.y);
+  });
+
+  this->starts.clear();
+}
+
+void ForceLayout::drain(std::unique_lock<std::mutex> &lock) {
+  while (this->nextChunk < this->chunks) {
+    size_t begin = this->nextChunk++ * this->chunkSize;
+    size_t end = std::min(begin + this->chunkSize, this->bodies.size());
+    float cx = this->centerX;
+    float cy = this->centerY;
+
+    lock.unlock();
+    this->accumulate(begin, end, cx, cy);
+    lock.lock();
+
+    if (--this->remaining == 0)
+      this->done.notify_all();
+  }
+}
+
+void ForceLayout::run() {
+  std::unique_lock<std::mutex> lock(this->mutex);
+  for (;;) {
+    this->wake.wait(lock, [this] {
+      return this->nextChunk < this->chunks || this->stopping;
+    });
+    if (this->stopping)
+      return;
+
+    this->drain(lock);
+  }
+}
+
+void ForceLayout::buildTree() {
+  float x1 = this->bodies[0].x, x2 = x1;
+  float y1 = this->bodies[0].y, y2 = y1;
+  for (const Body &body : this->bodies) {
+    x1 = std::min(x1, body.x);
+    x2 = std::max(x2, body.x);
+    y1 = std::min(y1, body.y);
+    y2 = std::max(y2, body.y);
+  }
+
+  this->cells.clear();
+  Cell root;
+  root.cx = (x1 + x2) / 2;
+  root.cy = (y1 + y2) / 2;
+  root.half = std::max(x2 - x1, y2 - y1) / 2 + 1;
+  this->cells.push_back(root);
+
+  this->next.assign(this->bodies.size(), -1);
+  for (int i = 0; i < static_cast<int>(this->bodies.size()); i++)
+    this->insert(i);
+}
+
+void ForceLayout::insert(int body) {
+  const Body &b = this->bodies[body];
+  int c = 0;
+
+  for (;;) {
+    // Indices, not references: childFor may grow `cells`.
+    this->cells[c].mass += b.mass;
+    this->cells[c].mx += b.mass * b.x;
+    this->cells[c].my += b.mass * b.y;
+
+    const Cell &cell = this->cells[c];
+    bool leaf = std::all_of(std::begin(cell.child), std::end(cell.child),
+                            [](int child) { return child < 0; });
+    if (!leaf) {
+      c = this->childFor(c, b.x, b.y);
+      continue;
+    }
+
+    if (cell.body < 0 || cell.half < minHalf) {
+      this->next[body] = cell.body;
+      this->cells[c].body = body;
+      return;
+    }
+
+    // Split: push the resident body down a level, then keep descending.
+    int resident = cell.body;
+    const Body &r = this->bodies[resident];
+    this->cells[c].body = -1;
+    int down = this->childFor(c, r.x, r.y);
+    this->cells[down].mass += r.mass;
+    this->cells[down].mx += r.mass * r.x;
+    this->cells[down].my += r.mass * r.y;
+    this->cells[down].body = resident;
+
+    c = this->childFor(c, b.x, b.y);
+  }
+}
+
+int ForceLayout::childFor(int cell, float x, float y) {
+  const Cell &parent = this->cells[cell];
+  int quadrant = (x >= parent.cx ? 1 : 0) + (y >= parent.cy ? 2 : 0);
+  if (parent.child[quadrant] >= 0)
+    return parent.child[quadrant];
+
+  Cell child;
+  child.half = parent.half / 2;
+  child.cx = parent.cx + (quadrant & 1 ? child.half : -child.half);
+  child.cy = parent.cy + (quadrant & 2 ? child.half : -child.half);
+
+  int index = static_cast<int>(this->cells.size());
+  this->cells[cell].child[quadrant] = index;
+  this->cells.push_back(child);
+  return index;
+}
+
+void ForceLayout::accumulate(size_t begin, size_t end, float cx, float cy) {
+  std::vector<int> stack;
+
+  for (size_t i = begin; i < end; i++) {
+    const Body &body = this->bodies[i];
+    Node *node = body.node;
+    float fx = 0;
+    float fy = 0;
+
+    auto push = [&](float mass, float x, float y, size_t salt) {
+      float dx = body.x - x;
+      float dy = body.y - y;
+      float d2 = dx * dx + dy * dy;
+      if (d2 == 0) {
+        // Stacked exactly: pick a direction that differs per pair.
+        float angle = static_cast<float>((i * 7919 + salt) % 628) / 100;
+        dx = std::cos(angle);
+        dy = std::sin(angle);
+        d2 = 1;
+      }
+      float d = std::sqrt(d2);
+      d2 = std::max(d2, minDistance * minDistance);
+      float f = repulsion * body.mass * mass / d2;
+      fx += f * dx / d;
+      fy += f * dy / d;
+    };
+
+    auto collide = [&](const Body &other) {
+      float dx = body.x - other.x;
+      float dy = body.y - other.y;
+      float d = std::sqrt(dx * dx + dy * dy);
+      float overlap = body.radius + other.radius + edgeGap / 2 - d;
+      if (overlap <= 0 || d == 0)
+        return;
+      fx += collision * overlap * other.mass * dx / d;
+      fy += collision * overlap * other.mass * dy / d;
+    };
+
+    stack.clear();
+    stack.push_back(0);
+    while (!stack.empty()) {
+      const Cell &cell = this->cells[stack.back()];
+      stack.pop_back();
+
+      if (cell.body >= 0 || cell.mass == 0) {
+        for (int other = cell.body; other >= 0; other = this->next[other]) {
+          if (static_cast<size_t>(other) == i)
+            continue;
+          const Body &b = this->bodies[other];
+          push(b.mass, b.x, b.y, other);
+          collide(b);
+        }
+        continue;
+      }
+
+      float comX = cell.mx / cell.mass;
+      float comY = cell.my / cell.mass;
+      float dx = body.x - comX;
+      float dy = body.y - comY;
+      // Cells that could hold a node close enough to collide are always
+      // opened.
+      float width = 2 * cell.half;
+      float d2 = dx * dx + dy * dy;
+      float reach = width + body.radius + this->maxRadius + edgeGap / 2;
+      if (width * width < theta * theta * d2 && d2 > reach * reach) {
+        push(cell.mass, comX, comY, 0);
+        continue;
+      }
+
+      for (int child : cell.child)
+        if (child >= 0)
+          stack.push_back(child);
+    }
+
+    auto spring = [&](uint32_t index) {
+      const Node *other = this->nodes->at(index);
+      float dx = other->x - body.x;
+      float dy = other->y - body.y;
+      float d = std::sqrt(dx * dx + dy * dy);
+      if (d == 0)
+        return;
+      float rest = node->radius + other->radius + edgeGap;
+      float f = springStrength * (d - rest);
+      fx += f * dx / d;
+      fy += f * dy / d;
+    };
+    for (uint32_t index : node->parents)
+      spring(index);
+    for (uint32_t index : node->children)
+      spring(index);
+
+    fx += gravity * body.mass * (cx - body.x);
+    fy += gravity * body.mass * (cy - body.y);
+
+    node->fx = fx / body.mass;
+    node->fy = fy / body.mass;
+  }
+}
@@ -0,0 +1,95 @@
+#ifndef FORCELAYOUT_H
+#define FORCELAYOUT_H
+
+#include "node.h"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Map;
+class NodeStore;
+
+// Live force-directed layout. Every edge is a spring whose rest length
+// clears both nodes' radii, every pair of nodes repels, and a weak pull
+// toward the centroid keeps separate trees from drifting apart. Repulsion
+// is approximated with a Barnes-Hut quadtree rebuilt each step, and the
+// per-node force sums are split into chunks shared between the calling
+// thread and a pool started with the layout. Node::tick then
+// integrates each node; pinned nodes and the held node don't move.
+//
+// Steps move nodes without recording anything. finish() records one Move
+// per node that ended up somewhere new, so a whole run is a single undo
+// step and reaches the journal once.
+class ForceLayout {
+public:
+  ForceLayout();
+  ForceLayout(const ForceLayout &) = delete;
+  ForceLayout &operator=(const ForceLayout &) = delete;
+  ~ForceLayout();
+
+  void step(Map &map, float dt, NodeId held);
+  void finish(Map &map);
+
+private:
+  struct Body {
+    Node *node;
+    float x;
+    float y;
+    float radius;
+    float mass;
+  };
+
+  struct Cell {
+    float cx;
+    float cy;
+    float half;
+    float mass = 0;
+    float mx = 0;
+    float my = 0;
+    int child[4] = {-1, -1, -1, -1};
+    int body = -1;
+  };
+
+  struct Start {
+    uint32_t generation;
+    float x;
+    float y;
+    bool seen = 0;
+  };
+
+  void buildTree();
+  void insert(int body);
+  int childFor(int cell, float x, float y);
+  void accumulate(size_t begin, size_t end, float cx, float cy);
+  // Takes chunks of the current step until none are left; lock is held on
+  // entry and exit.
+  void drain(std::unique_lock<std::mutex> &lock);
+  void run();
+
+  const NodeStore *nodes = nullptr;
+
+  std::vector<Body> bodies;
+  float maxRadius = 0;
+  std::vector<Cell> cells;
+  // Bodies sharing a leaf that is too small to split, chained by index.
+  std::vector<int> next;
+  std::vector<Start> starts;
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  // The step being shared out: bodies are split into `chunks` runs of
+  // chunkSize, handed out in order, and the step ends when none remain.
+  size_t chunks = 0;
+  size_t chunkSize = 0;
+  size_t nextChunk = 0;
+  size_t remaining = 0;
+  float centerX = 0;
+  float centerY = 0;
+  bool stopping = 0;
+};
+
+#endif
@@ -0,0 +1,367 @@
+#include "glyphatlas.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr int glyphPadding = 1;
+
+static constexpr int spread = GlyphRasterizer::spread;
+
+// Time each frame may spend packing and uploading glyphs from the workers;
+// the rest wait for the next frame.
+static constexpr auto collectBudget = std::chrono::milliseconds(4);
+
+// Placeholder bars cover the middle of the line, drawn at this fraction of
+// the text's alpha.
+static constexpr float placeholderTop = 0.35f;
+static constexpr float placeholderBottom = 0.65f;
+static constexpr float placeholderAlpha = 0.25f;
+
+GlyphAtlas *GlyphAtlas::get(SDL_Renderer *renderer, TTF_Font *font) {
+  auto &atlas = atlases[{renderer, font}];
+  if (!atlas)
+    atlas.reset(new GlyphAtlas(renderer, font));
+  return atlas.get();
+}
+
+void GlyphAtlas::flushAll(SDL_Renderer *renderer, float zoom) {
+  Clock::time_point deadline = Clock::now() + collectBudget;
+  for (auto &[key, atlas] : atlases) {
+    if (key.first == renderer) {
+      atlas->flush(zoom);
+      atlas->collect(deadline);
+    }
+  }
+}
+
+bool GlyphAtlas::isLoading() {
+  for (auto &[key, atlas] : atlases)
+    if (atlas->rasterizer && atlas->rasterizer->getOutstanding() > 0)
+      return true;
+  return false;
+}
+
+void GlyphAtlas::destroyAll() { atlases.clear(); }
+
+void GlyphAtlas::setMemoryBudget(size_t bytes) {
+  maxPages = std::max<size_t>(1, bytes / pageBytes);
+}
+
+void GlyphAtlas::setFontFile(TTF_Font *font, const std::string &path,
+                             int pointSize) {
+  fontFiles[font] = {path, pointSize};
+}
+
+GlyphAtlas::GlyphAtlas(SDL_Renderer *renderer, TTF_Font *font)
+    : renderer(renderer), font(font), metrics(FontMetrics::get(font)) {
+  auto it = fontFiles.find(font);
+  if (it != fontFiles.end()) {
+    auto rasterizer = std::make_unique<GlyphRasterizer>(
+        it->second.path,
+        it->second.pointSize * GlyphRasterizer::oversample,
+        GlyphRasterizer::oversample / GlyphRasterizer::texelScale);
+    if (rasterizer->isRunning()) {
+      this->rasterizer = std::move(rasterizer);
+      this->texelScale = GlyphRasterizer::texelScale;
+    }
+  }
+}
+
+GlyphAtlas::~GlyphAtlas() {
+  for (Page &page : this->pages)
+    if (page.texture)
+      SDL_DestroyTexture(page.texture);
+  totalPages -= this->pages.size();
+}
+
+int GlyphAtlas::getLineHeight() const {
+  return this->metrics->getLineHeight();
+}
+
+bool GlyphAtlas::addPage() {
+  SDL_Texture *texture =
+      SDL_CreateTexture(this->renderer, SDL_PIXELFORMAT_ARGB8888,
+                        SDL_TEXTUREACCESS_STATIC, pageSize, pageSize);
+
+  if (!texture) {
+    std::cout << "SDL_CreateTexture failed: " << SDL_GetError() << '\n';
+    return false;
+  }
+
+  // Start fully transparent so filtering at glyph edges never picks up junk.
+  std::vector<Uint32> clear(pageSize * pageSize, 0);
+  SDL_UpdateTexture(texture, nullptr, clear.data(), pageSize * 4);
+  SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+  Page page;
+  page.texture = texture;
+  page.field.assign(size_t(pageSize) * pageSize, 0);
+  this->pages.push_back(std::move(page));
+  totalPages++;
+  return true;
+}
+
+bool GlyphAtlas::nextPage() {
+  if (!this->pages.empty() && this->currentPage + 1 < this->pages.size()) {
+    this->currentPage++;
+  } else if (this->pages.empty() || totalPages < maxPages) {
+    if (!this->addPage())
+      return false;
+    this->currentPage = this->pages.size() - 1;
+  } else {
+    this->recycle();
+  }
+
+  this->cursorX = 0;
+  this->cursorY = 0;
+  this->rowHeight = 0;
+  return true;
+}
+
+void GlyphAtlas::recycle() {
+  // Glyphs already queued this frame still point at the old contents.
+  this->draw();
+
+  for (Glyph &glyph : this->ascii)
+    glyph = Glyph();
+  this->extended.clear();
+
+  std::vector<Uint32> clear(pageSize * pageSize, 0);
+  for (Page &page : this->pages) {
+    SDL_UpdateTexture(page.texture, nullptr, clear.data(), pageSize * 4);
+    std::fill(page.field.begin(), page.field.end(), 0);
+    page.usedHeight = 0;
+  }
+
+  this->currentPage = 0;
+}
+
+void GlyphAtlas::upload(Page &page, const SDL_Rect &rect) {
+  std::vector<Uint32> pixels(size_t(rect.w) * rect.h);
+  for (int y = 0; y < rect.h; y++) {
+    const uint8_t *field = &page.field[size_t(rect.y + y) * pageSize + rect.x];
+    Uint32 *row = &pixels[size_t(y) * rect.w];
+    for (int x = 0; x < rect.w; x++)
+      row[x] = (Uint32(this->coverage[field[x]]) << 24) | 0xFFFFFF;
+  }
+  SDL_UpdateTexture(page.texture, &rect, pixels.data(), rect.w * 4);
+}
+
+void GlyphAtlas::setZoom(float zoom) {
+  if (zoom == this->zoom)
+    return;
+  this->zoom = zoom;
+
+  // A texel is zoom / texelScale screen pixels.
+  GlyphRasterizer::coverage(zoom / this->texelScale, this->coverage);
+
+  for (Page &page : this->pages)
+    if (page.usedHeight > 0)
+      this->upload(page, {0, 0, pageSize, page.usedHeight});
+}
+
+GlyphAtlas::Glyph GlyphAtlas::place(const GlyphRasterizer::Field &field) {
+  Glyph glyph;
+  glyph.loaded = true;
+  if (field.data.empty())
+    return glyph;
+
+  int w = field.w + glyphPadding;
+  int h = field.h + glyphPadding;
+
+  if (this->cursorX + w > pageSize) {
+    this->cursorX = 0;
+    this->cursorY += this->rowHeight;
+    this->rowHeight = 0;
+  }
+
+  if (this->pages.empty() || this->cursorY + h > pageSize) {
+    if (!this->nextPage())
+      return glyph;
+  }
+
+  glyph.page = static_cast<int>(this->currentPage);
+  glyph.src = {this->cursorX, this->cursorY, field.w, field.h};
+
+  Page &page = this->pages[this->currentPage];
+  for (int y = 0; y < field.h; y++)
+    std::copy(&field.data[size_t(y) * field.w],
+              &field.data[size_t(y) * field.w] + field.w,
+              &page.field[size_t(glyph.src.y + y) * pageSize + glyph.src.x]);
+  page.usedHeight = std::max(page.usedHeight, glyph.src.y + field.h);
+  if (this->zoom > 0)
+    this->upload(page, glyph.src);
+
+  this->cursorX += w;
+  if (h > this->rowHeight)
+    this->rowHeight = h;
+
+  return glyph;
+}
+
+GlyphAtlas::Glyph *GlyphAtlas::find(Uint32 codepoint) {
+  if (codepoint < 128)
+    return &this->ascii[codepoint];
+
+  auto it = this->extended.find(codepoint);
+  return it != this->extended.end() ? &it->second : nullptr;
+}
+
+void GlyphAtlas::store(Uint32 codepoint, const Glyph &glyph) {
+  if (codepoint < 128)
+    this->ascii[codepoint] = glyph;
+  else
+    this->extended[codepoint] = glyph;
+}
+
+const GlyphAtlas::Glyph &GlyphAtlas::glyph(Uint32 codepoint) {
+  Glyph *known = this->find(codepoint);
+  if (known && (known->loaded || known->pending))
+    return *known;
+
+  Glyph glyph;
+  if (this->rasterizer) {
+    glyph.pending = true;
+    this->rasterizer->request(codepoint);
+  } else {
+    // Placing may recycle the atlas and wipe both tables, so only store the
+    // result once it is done.
+    GlyphRasterizer::Field field;
+    GlyphRasterizer::build(this->font, codepoint, 1, field);
+    glyph = this->place(field);
+  }
+
+  this->store(codepoint, glyph);
+  return *this->find(codepoint);
+}
+
+void GlyphAtlas::collect(std::chrono::steady_clock::time_point deadline) {
+  if (!this->rasterizer)
+    return;
+
+  // Always take at least one so text still fills in on slow frames.
+  GlyphRasterizer::Field field;
+  do {
+    if (!this->rasterizer->takeFinished(field))
+      return;
+
+    // A glyph asked for twice, around a recycle, arrives twice.
+    Glyph *known = this->find(field.codepoint);
+    if (known && known->loaded)
+      continue;
+
+    Glyph glyph = this->place(field);
+    this->store(field.codepoint, glyph);
+  } while (Clock::now() < deadline);
+}
+
+void GlyphAtlas::queuePlaceholder(float x, float y, int width,
+                                  SDL_Color color) {
+  float lineHeight = static_cast<float>(this->metrics->getLineHeight());
+  float x2 = x + width;
+  float y1 = y + lineHeight * placeholderTop;
+  float y2 = y + lineHeight * placeholderBottom;
+  color.a = static_cast<Uint8>(color.a * placeholderAlpha);
+
+  int base = static_cast<int>(this->placeholderVertices.size());
+  this->placeholderVertices.push_back({{x, y1}, color, {0, 0}});
+  this->placeholderVertices.push_back({{x2, y1}, color, {0, 0}});
+  this->placeholderVertices.push_back({{x2, y2}, color, {0, 0}});
+  this->placeholderVertices.push_back({{x, y2}, color, {0, 0}});
+  this->placeholderIndices.insert(
+      this->placeholderIndices.end(),
+      {base, base + 1, base + 2, base, base + 2, base + 3});
+}
+
+void GlyphAtlas::queueText(const std::string &text, size_t begin, size_t end,
+                           float x, float y, SDL_Color color) {
+  // A line still waiting on the workers shows as a bar until all of its
+  // glyphs are in, so labels never appear half drawn.
+  bool ready = true;
+  for (size_t i = begin; i < end;)
+    if (this->glyph(decodeUtf8(text, i)).pending)
+      ready = false;
+  if (!ready) {
+    this->queuePlaceholder(x, y, this->metrics->measure(text, begin, end),
+                           color);
+    return;
+  }
+
+  float penX = x;
+  Uint32 prev = 0;
+  // Fields carry a border of `spread` texels on every side.
+  float scale = 1.0f / this->texelScale;
+  float border = static_cast<float>(spread) * scale;
+
+  size_t i = begin;
+  while (i < end) {
+    Uint32 cp = decodeUtf8(text, i);
+    const Glyph &g = this->glyph(cp);
+
+    if (prev)
+      penX += this->metrics->kerning(prev, cp);
+    prev = cp;
+
+    if (g.page >= 0) {
+      Page &page = this->pages[g.page];
+      int base = static_cast<int>(page.vertices.size());
+
+      float u1 = static_cast<float>(g.src.x) / pageSize;
+      float v1 = static_cast<float>(g.src.y) / pageSize;
+      float u2 = static_cast<float>(g.src.x + g.src.w) / pageSize;
+      float v2 = static_cast<float>(g.src.y + g.src.h) / pageSize;
+
+      float x1 = penX - border;
+      float y1 = y - border;
+      float x2 = x1 + g.src.w * scale;
+      float y2 = y1 + g.src.h * scale;
+
+      page.vertices.push_back({{x1, y1}, color, {u1, v1}});
+      page.vertices.push_back({{x2, y1}, color, {u2, v1}});
+      page.vertices.push_back({{x2, y2}, color, {u2, v2}});
+      page.vertices.push_back({{x1, y2}, color, {u1, v2}});
+
+      page.indices.insert(page.indices.end(), {base, base + 1, base + 2, base,
+                                               base + 2, base + 3});
+    }
+
+    penX += this->metrics->advance(cp);
+  }
+}
+
+void GlyphAtlas::flush(float zoom) {
+  this->setZoom(zoom);
+  this->draw();
+}
+
+void GlyphAtlas::draw() {
+  if (!this->placeholderIndices.empty()) {
+    if (SDL_RenderGeometry(this->renderer, nullptr,
+                           this->placeholderVertices.data(),
+                           static_cast<int>(this->placeholderVertices.size()),
+                           this->placeholderIndices.data(),
+                           static_cast<int>(this->placeholderIndices.size())) !=
+        0) {
+      std::cout << "SDL_RenderGeometry failed: " << SDL_GetError() << '\n';
+    }
+    this->placeholderVertices.clear();
+    this->placeholderIndices.clear();
+  }
+
+  for (Page &page : this->pages) {
+    if (page.indices.empty())
+      continue;
+
+    if (SDL_RenderGeometry(this->renderer, page.texture, page.vertices.data(),
+                           static_cast<int>(page.vertices.size()),
+                           page.indices.data(),
+                           static_cast<int>(page.indices.size())) != 0) {
+      std::cout << "SDL_RenderGeometry failed: " << SDL_GetError() << '\n';
+    }
+
+    page.vertices.clear();
+    page.indices.clear();
+  }
+}
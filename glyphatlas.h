@@ -0,0 +1,134 @@
+#ifndef GLYPHATLAS_H
+#define GLYPHATLAS_H
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include "glyphrasterizer.h"
+#include "textlayout.h"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// One texture atlas per (renderer, font) pair, shared by every node using
+// that font. Glyphs are stored as signed distance fields, built once from an
+// oversampled rendering of the font file, so labels stay sharp at any zoom;
+// text is queued as textured quads and drawn with one SDL_RenderGeometry
+// call per atlas page.
+//
+// SDL's renderer has no shaders, so distance is turned into coverage on the
+// CPU: each page keeps its raw field and, when the zoom changes, is pushed
+// through a 256-entry lookup table that puts a one-pixel edge ramp at the
+// current scale. That costs one pass over the used part of each page, and
+// no glyph is ever rasterized again.
+//
+// With a font file registered, fields are built by a GlyphRasterizer pool
+// and packed into pages at the end of each frame, within a time budget.
+// Lines waiting on a glyph draw as a faint bar in the meantime.
+//
+// Pages count against a shared texture memory budget; an atlas that needs
+// more draws what it has queued and starts over on its existing pages.
+class GlyphAtlas {
+public:
+  static GlyphAtlas *get(SDL_Renderer *renderer, TTF_Font *font);
+  // Draws everything queued for renderer, scaled by zoom, then packs
+  // glyphs finished since the last frame.
+  static void flushAll(SDL_Renderer *renderer, float zoom);
+  // True while glyphs are still being built, so callers keep drawing.
+  static bool isLoading();
+  static void destroyAll();
+
+  static void setMemoryBudget(size_t bytes);
+  // Tells atlases where font was loaded from so they can build their fields
+  // from larger copies on worker threads. Without it glyphs come from font
+  // itself, softer and on the calling thread.
+  static void setFontFile(TTF_Font *font, const std::string &path,
+                          int pointSize);
+
+  ~GlyphAtlas();
+
+  void queueText(const std::string &text, size_t begin, size_t end, float x,
+                 float y, SDL_Color color);
+  void flush(float zoom);
+
+  int getLineHeight() const;
+
+private:
+  struct Glyph {
+    bool loaded = false;
+    bool pending = false;
+    int page = -1;
+    SDL_Rect src = {0, 0, 0, 0};
+  };
+
+  struct Page {
+    SDL_Texture *texture = nullptr;
+    // Signed distance per texel, 128 on the outline.
+    std::vector<uint8_t> field;
+    int usedHeight = 0;
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int> indices;
+  };
+
+  struct FontFile {
+    std::string path;
+    int pointSize;
+  };
+
+  GlyphAtlas(SDL_Renderer *renderer, TTF_Font *font);
+
+  const Glyph &glyph(Uint32 codepoint);
+  Glyph *find(Uint32 codepoint);
+  void store(Uint32 codepoint, const Glyph &glyph);
+  void collect(std::chrono::steady_clock::time_point deadline);
+  bool addPage();
+  bool nextPage();
+  void recycle();
+  Glyph place(const GlyphRasterizer::Field &field);
+  void upload(Page &page, const SDL_Rect &rect);
+  void setZoom(float zoom);
+  void queuePlaceholder(float x, float y, int width, SDL_Color color);
+  void draw();
+
+  static constexpr int pageSize = 1024;
+  // Coverage texture plus the raw field kept to re-map it.
+  static constexpr size_t pageBytes = size_t(pageSize) * pageSize * 5;
+
+  inline static size_t maxPages = 16;
+  inline static size_t totalPages = 0;
+
+  inline static std::map<std::pair<SDL_Renderer *, TTF_Font *>,
+                         std::unique_ptr<GlyphAtlas>>
+      atlases;
+  inline static std::map<TTF_Font *, FontFile> fontFiles;
+
+  SDL_Renderer *renderer;
+  TTF_Font *font;
+  FontMetrics *metrics;
+
+  // Builds fields from larger copies of font; texels per font pixel in the
+  // atlas.
+  std::unique_ptr<GlyphRasterizer> rasterizer;
+  int texelScale = 1;
+
+  float zoom = 0;
+  uint8_t coverage[256];
+
+  Glyph ascii[128];
+  std::unordered_map<Uint32, Glyph> extended;
+
+  std::vector<Page> pages;
+  std::vector<SDL_Vertex> placeholderVertices;
+  std::vector<int> placeholderIndices;
+  size_t currentPage = 0;
+
+  int cursorX = 0;
+  int cursorY = 0;
+  int rowHeight = 0;
+};
+
+#endif
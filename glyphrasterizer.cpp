@@ -0,0 +1,230 @@
+#include "glyphrasterizer.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Most threads the pool starts; the render thread keeps one core.
+static constexpr unsigned maxWorkers = 4;
+
+static constexpr double infinity = 1e20;
+
+// Exact squared Euclidean distance transform of one row or column
+// (Felzenszwalb & Huttenlocher): d[q] = min over p of (q - p)^2 + f[p].
+static void distance1d(const double *f, double *d, int n, int *v, double *z) {
+  int k = 0;
+  v[0] = 0;
+  z[0] = -infinity;
+  z[1] = infinity;
+  for (int q = 1; q < n; q++) {
+    double s;
+    for (;;) {
+      int p = v[k];
+      s = ((f[q] + double(q) * q) - (f[p] + double(p) * p)) / (2.0 * (q - p));
+      if (s > z[k])
+        break;
+      k--;
+    }
+    k++;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = infinity;
+  }
+
+  k = 0;
+  for (int q = 0; q < n; q++) {
+    while (z[k + 1] < q)
+      k++;
+    double dq = q - v[k];
+    d[q] = dq * dq + f[v[k]];
+  }
+}
+
+// Squared distance from every cell to the nearest cell where grid is 0.
+static void distance2d(std::vector<double> &grid, int w, int h) {
+  int n = std::max(w, h);
+  std::vector<double> f(n), d(n), z(n + 1);
+  std::vector<int> v(n);
+
+  for (int x = 0; x < w; x++) {
+    for (int y = 0; y < h; y++)
+      f[y] = grid[size_t(y) * w + x];
+    distance1d(f.data(), d.data(), h, v.data(), z.data());
+    for (int y = 0; y < h; y++)
+      grid[size_t(y) * w + x] = d[y];
+  }
+
+  for (int y = 0; y < h; y++) {
+    distance1d(&grid[size_t(y) * w], d.data(), w, v.data(), z.data());
+    std::copy(d.begin(), d.begin() + w, grid.begin() + size_t(y) * w);
+  }
+}
+
+bool GlyphRasterizer::build(TTF_Font *font, Uint32 codepoint, int step,
+                            Field &field) {
+  field.codepoint = codepoint;
+  field.data.clear();
+  field.w = field.h = 0;
+
+  SDL_Surface *rendered = TTF_RenderGlyph32_Blended(
+      font, codepoint, SDL_Color{255, 255, 255, 255});
+  if (!rendered)
+    return false;
+
+  SDL_Surface *surface =
+      SDL_ConvertSurfaceFormat(rendered, SDL_PIXELFORMAT_ARGB8888, 0);
+  SDL_FreeSurface(rendered);
+
+  if (!surface) {
+    std::cout << "SDL_ConvertSurfaceFormat failed: " << SDL_GetError()
+              << '\n';
+    return false;
+  }
+
+  // Work on the source grid with a border wide enough for the whole spread,
+  // then average blocks of `step` source pixels into each texel.
+  int border = spread * step;
+  int sw = surface->w + 2 * border;
+  int sh = surface->h + 2 * border;
+
+  std::vector<double> toInk(size_t(sw) * sh, infinity);
+  std::vector<double> toPaper(size_t(sw) * sh, 0);
+  for (int y = 0; y < surface->h; y++) {
+    const Uint32 *row = reinterpret_cast<const Uint32 *>(
+        static_cast<const Uint8 *>(surface->pixels) + y * surface->pitch);
+    for (int x = 0; x < surface->w; x++) {
+      if ((row[x] >> 24) < 128)
+        continue;
+      size_t at = size_t(y + border) * sw + x + border;
+      toInk[at] = 0;
+      toPaper[at] = infinity;
+    }
+  }
+  SDL_FreeSurface(surface);
+  distance2d(toInk, sw, sh);
+  distance2d(toPaper, sw, sh);
+
+  int w = (sw + step - 1) / step;
+  int h = (sh + step - 1) / step;
+  field.data.assign(size_t(w) * h, 0);
+  field.w = w;
+  field.h = h;
+
+  for (int ty = 0; ty < h; ty++) {
+    for (int tx = 0; tx < w; tx++) {
+      double sum = 0;
+      int count = 0;
+      for (int y = ty * step; y < std::min(sh, (ty + 1) * step); y++) {
+        for (int x = tx * step; x < std::min(sw, (tx + 1) * step); x++) {
+          size_t at = size_t(y) * sw + x;
+          // Positive inside; the outline sits half a pixel from both.
+          sum += toPaper[at] > 0 ? std::sqrt(toPaper[at]) - 0.5
+                                 : 0.5 - std::sqrt(toInk[at]);
+          count++;
+        }
+      }
+      double distance = sum / count / step;
+      double value = 128 + distance * 127 / spread;
+      field.data[size_t(ty) * w + tx] =
+          static_cast<uint8_t>(std::clamp(value, 0.0, 255.0) + 0.5);
+    }
+  }
+  return true;
+}
+
+void GlyphRasterizer::coverage(float pixelsPerTexel, uint8_t table[256]) {
+  // One field unit is spread / 127 texels.
+  float pixelsPerUnit = spread / 127.0f * pixelsPerTexel;
+  for (int v = 0; v < 256; v++) {
+    float alpha = 0.5f + (v - 128) * pixelsPerUnit;
+    table[v] =
+        static_cast<uint8_t>(std::clamp(alpha, 0.0f, 1.0f) * 255 + 0.5f);
+  }
+}
+
+GlyphRasterizer::GlyphRasterizer(const std::string &path, int pointSize,
+                                 int step)
+    : step(step) {
+  unsigned threads = std::clamp(std::thread::hardware_concurrency(), 2u,
+                                maxWorkers + 1) - 1;
+
+  // FreeType shares one library between faces, so fonts are opened here
+  // rather than racing each other on the workers.
+  for (unsigned i = 0; i < threads; i++) {
+    TTF_Font *font = TTF_OpenFont(path.c_str(), pointSize);
+    if (!font) {
+      std::cout << "TTF_OpenFont failed: " << TTF_GetError() << '\n';
+      break;
+    }
+    this->fonts.push_back(font);
+  }
+
+  for (TTF_Font *font : this->fonts)
+    this->workers.emplace_back(&GlyphRasterizer::run, this, font);
+}
+
+GlyphRasterizer::~GlyphRasterizer() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = 1;
+  }
+  this->wake.notify_all();
+  for (std::thread &worker : this->workers)
+    worker.join();
+
+  for (TTF_Font *font : this->fonts)
+    TTF_CloseFont(font);
+}
+
+bool GlyphRasterizer::isRunning() const { return !this->workers.empty(); }
+
+void GlyphRasterizer::request(Uint32 codepoint) {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->requests.push_back(codepoint);
+    this->outstanding++;
+  }
+  this->wake.notify_one();
+}
+
+bool GlyphRasterizer::takeFinished(Field &field, bool wait) {
+  std::unique_lock<std::mutex> lock(this->mutex);
+  if (wait)
+    this->ready.wait(lock, [this] {
+      return !this->finished.empty() || this->outstanding == 0;
+    });
+  if (this->finished.empty())
+    return false;
+
+  field = std::move(this->finished.back());
+  this->finished.pop_back();
+  this->outstanding--;
+  return true;
+}
+
+size_t GlyphRasterizer::getOutstanding() {
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->outstanding;
+}
+
+void GlyphRasterizer::run(TTF_Font *font) {
+  std::unique_lock<std::mutex> lock(this->mutex);
+  for (;;) {
+    this->wake.wait(lock, [this] {
+      return !this->requests.empty() || this->stopping;
+    });
+    if (this->stopping)
+      return;
+
+    Uint32 codepoint = this->requests.front();
+    this->requests.pop_front();
+    lock.unlock();
+
+    // Failures still come back, empty, so the glyph stops being pending.
+    Field field;
+    GlyphRasterizer::build(font, codepoint, this->step, field);
+
+    lock.lock();
+    this->finished.push_back(std::move(field));
+    this->ready.notify_all();
+  }
+}
@@ -0,0 +1,74 @@
+#ifndef GLYPHRASTERIZER_H
+#define GLYPHRASTERIZER_H
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Builds glyph distance fields on a pool of worker threads, each with its
+// own TTF_Font opened from the same file since fonts can't be shared across
+// threads. Requests are served in the order they arrive; finished fields
+// wait until the owner takes them on its own thread, which is the only one
+// that touches textures.
+class GlyphRasterizer {
+public:
+  // Distance, in texels, covered by the 0..255 range either side of the
+  // outline. Also the border kept around each glyph so the field can fade.
+  static constexpr int spread = 6;
+  // Fonts are rendered at oversample times their point size and averaged
+  // down to texelScale texels per font pixel.
+  static constexpr int oversample = 4;
+  static constexpr int texelScale = 2;
+
+  struct Field {
+    Uint32 codepoint = 0;
+    std::vector<uint8_t> data;
+    int w = 0;
+    int h = 0;
+  };
+
+  // Renders codepoint with font and averages blocks of step pixels into
+  // each texel of the field. Safe to call from any thread that owns font.
+  static bool build(TTF_Font *font, Uint32 codepoint, int step, Field &field);
+  // Maps field values to alpha with a one pixel ramp at the outline, for
+  // fields drawn at pixelsPerTexel screen pixels per texel.
+  static void coverage(float pixelsPerTexel, uint8_t table[256]);
+
+  GlyphRasterizer(const std::string &path, int pointSize, int step);
+  GlyphRasterizer(const GlyphRasterizer &) = delete;
+  GlyphRasterizer &operator=(const GlyphRasterizer &) = delete;
+  // Drops queued requests and waits for glyphs already being built.
+  ~GlyphRasterizer();
+
+  // False if no copy of the font could be opened.
+  bool isRunning() const;
+
+  void request(Uint32 codepoint);
+  // With wait, blocks until a field is ready unless nothing is outstanding.
+  bool takeFinished(Field &field, bool wait = false);
+  // Requests not yet taken back with takeFinished.
+  size_t getOutstanding();
+
+private:
+  void run(TTF_Font *font);
+
+  std::vector<TTF_Font *> fonts;
+  std::vector<std::thread> workers;
+  int step;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable ready;
+  std::deque<Uint32> requests;
+  std::vector<Field> finished;
+  size_t outstanding = 0;
+  bool stopping = 0;
+};
+
+#endif
@@ -0,0 +1,363 @@
+#include "hierarchylayout.h"
+#include "map.h"
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <unordered_map>
+
+// Clear space between the rims of neighbours in a layer, and between the
+// largest nodes of consecutive layers.
+static constexpr float nodeGap = 40;
+static constexpr float layerGap = 120;
+
+// Width reserved for the bend point of an edge passing through a layer.
+static constexpr float dummyRadius = 10;
+
+// Down-and-up barycenter passes per trial, and the most trials run side by
+// side.
+static constexpr int sweeps = 12;
+static constexpr unsigned maxTrials = 8;
+
+// Placement passes pulling each layer toward its neighbours.
+static constexpr int placementPasses = 8;
+
+void HierarchyLayout::apply(Map &map, Node *root) {
+  std::vector<uint32_t> members;
+  if (root) {
+    members = map.order.descendants(root->getId().index);
+  } else {
+    map.nodes.forEach(
+        [&](Node *node) { members.push_back(node->getId().index); });
+    std::sort(members.begin(), members.end(), [&](uint32_t a, uint32_t b) {
+      return map.order.getRank(a) < map.order.getRank(b);
+    });
+  }
+  if (members.empty())
+    return;
+
+  HierarchyLayout layout(map);
+  layout.build(members, root);
+  layout.order();
+  layout.place();
+
+  // Keep the picture anchored where the user was looking.
+  float oldX = 0, oldY = 0, newX = 0, newY = 0;
+  if (root) {
+    oldX = root->getX();
+    oldY = root->getY();
+    newX = layout.vertices[0].x;
+    newY = 0;
+  } else {
+    size_t count = 0;
+    for (const Vertex &v : layout.vertices) {
+      if (!v.node)
+        continue;
+      oldX += v.node->getX();
+      oldY += v.node->getY();
+      newX += v.x;
+      count++;
+    }
+    oldX /= count;
+    oldY /= count;
+    newX /= count;
+  }
+
+  std::vector<float> layerY(layout.layers.size(), 0);
+  float maxRadius = 0;
+  for (size_t l = 0; l < layout.layers.size(); l++) {
+    float radius = 0;
+    for (int v : layout.layers[l])
+      radius = std::max(radius, layout.vertices[v].radius);
+    if (l > 0)
+      layerY[l] = layerY[l - 1] + maxRadius + radius + layerGap;
+    maxRadius = radius;
+  }
+
+  if (!root) {
+    size_t count = 0;
+    for (const Vertex &v : layout.vertices) {
+      if (!v.node)
+        continue;
+      newY += layerY[v.layer];
+      count++;
+    }
+    newY /= count;
+  }
+
+  // Move everything before reindexing anything: updating edges while half
+  // the map is still in its old place would thread long transient segments
+  // through the index.
+  for (const Vertex &v : layout.vertices) {
+    if (!v.node)
+      continue;
+    Node *node = v.node;
+    float x = node->x;
+    float y = node->y;
+    node->x = v.x - newX + oldX;
+    node->y = layerY[v.layer] - newY + oldY;
+    if (node->x != x || node->y != y)
+      node->recordMove(x, y);
+  }
+  for (const Vertex &v : layout.vertices)
+    if (v.node)
+      v.node->reindex();
+}
+
+void HierarchyLayout::build(const std::vector<uint32_t> &members,
+                            Node *root) {
+  // members arrive in rank order, so every parent is seen before its
+  // children and one pass settles the longest-path layers.
+  std::unordered_map<uint32_t, int> vertexOf;
+  vertexOf.reserve(members.size());
+  for (uint32_t index : members) {
+    Node *node = this->map.nodes.at(index);
+    vertexOf[index] = static_cast<int>(this->vertices.size());
+    this->vertices.push_back({node, node->getRadius(), 0, node->getX(), {}, {}});
+  }
+
+  for (size_t i = 0; i < members.size(); i++) {
+    Vertex &v = this->vertices[i];
+    if (v.node == root)
+      continue;
+    for (uint32_t parent : v.node->getParents()) {
+      auto it = vertexOf.find(parent);
+      if (it != vertexOf.end())
+        v.layer = std::max(v.layer, this->vertices[it->second].layer + 1);
+    }
+  }
+
+  int layerCount = 0;
+  for (const Vertex &v : this->vertices)
+    layerCount = std::max(layerCount, v.layer + 1);
+
+  size_t real = this->vertices.size();
+  for (size_t i = 0; i < real; i++) {
+    for (uint32_t child : this->vertices[i].node->getChildren()) {
+      auto it = vertexOf.find(child);
+      if (it == vertexOf.end())
+        continue;
+
+      int from = static_cast<int>(i);
+      int to = it->second;
+      int fromLayer = this->vertices[from].layer;
+      int toLayer = this->vertices[to].layer;
+      float fromX = this->vertices[from].x;
+      float toX = this->vertices[to].x;
+
+      // One dummy per layer crossed, spaced along the current edge so the
+      // starting order follows the existing drawing.
+      int prev = from;
+      for (int l = fromLayer + 1; l < toLayer; l++) {
+        float t = static_cast<float>(l - fromLayer) / (toLayer - fromLayer);
+        int dummy = static_cast<int>(this->vertices.size());
+        this->vertices.push_back(
+            {nullptr, dummyRadius, l, fromX + (toX - fromX) * t, {prev}, {}});
+        this->vertices[prev].down.push_back(dummy);
+        prev = dummy;
+      }
+      this->vertices[prev].down.push_back(to);
+      this->vertices[to].up.push_back(prev);
+    }
+  }
+
+  this->layers.assign(layerCount, {});
+  for (int v = 0; v < static_cast<int>(this->vertices.size()); v++)
+    this->layers[this->vertices[v].layer].push_back(v);
+
+  for (std::vector<int> &layer : this->layers)
+    std::stable_sort(layer.begin(), layer.end(), [&](int a, int b) {
+      return this->vertices[a].x < this->vertices[b].x;
+    });
+}
+
+void HierarchyLayout::order() {
+  unsigned trials =
+      std::max(1u, std::min(std::thread::hardware_concurrency(), maxTrials));
+
+  std::vector<Layers> results(trials, this->layers);
+  std::vector<long long> scores(trials, 0);
+
+  auto run = [&](unsigned trial) {
+    Layers &layers = results[trial];
+    // Trial 0 starts from the current drawing; the rest from shuffles.
+    if (trial > 0) {
+      std::mt19937 rng(trial);
+      for (std::vector<int> &layer : layers)
+        std::shuffle(layer.begin(), layer.end(), rng);
+    }
+
+    std::vector<int> pos(this->vertices.size());
+    for (const std::vector<int> &layer : layers)
+      for (size_t i = 0; i < layer.size(); i++)
+        pos[layer[i]] = static_cast<int>(i);
+
+    Layers best = layers;
+    long long bestScore = this->crossings(layers, pos);
+    for (int s = 0; s < sweeps && bestScore > 0; s++) {
+      this->sweep(layers, pos, true);
+      this->sweep(layers, pos, false);
+
+      long long score = this->crossings(layers, pos);
+      if (score < bestScore) {
+        bestScore = score;
+        best = layers;
+      }
+    }
+
+    results[trial] = std::move(best);
+    scores[trial] = bestScore;
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned t = 1; t < trials; t++)
+    workers.emplace_back(run, t);
+  run(0);
+  for (std::thread &worker : workers)
+    worker.join();
+
+  size_t best = std::min_element(scores.begin(), scores.end()) - scores.begin();
+  this->layers = std::move(results[best]);
+}
+
+void HierarchyLayout::sweep(Layers &layers, std::vector<int> &pos,
+                            bool down) const {
+  std::vector<std::pair<double, int>> keyed;
+  int count = static_cast<int>(layers.size());
+
+  for (int step = 1; step < count; step++) {
+    std::vector<int> &layer = layers[down ? step : count - 1 - step];
+
+    keyed.clear();
+    for (int v : layer) {
+      const std::vector<int> &adjacent =
+          down ? this->vertices[v].up : this->vertices[v].down;
+      // Vertices with nothing on the fixed side keep their slot.
+      double key = pos[v];
+      if (!adjacent.empty()) {
+        double sum = 0;
+        for (int u : adjacent)
+          sum += pos[u];
+        key = sum / adjacent.size();
+      }
+      keyed.push_back({key, v});
+    }
+
+    std::stable_sort(keyed.begin(), keyed.end(),
+                     [](const std::pair<double, int> &a,
+                        const std::pair<double, int> &b) {
+                       return a.first < b.first;
+                     });
+    for (size_t i = 0; i < keyed.size(); i++) {
+      layer[i] = keyed[i].second;
+      pos[layer[i]] = static_cast<int>(i);
+    }
+  }
+}
+
+long long HierarchyLayout::crossings(const Layers &layers,
+                                     const std::vector<int> &pos) const {
+  // Two edges between a pair of layers cross when their endpoint orders
+  // disagree: sort by upper endpoint and count inversions of the lower one
+  // with a Fenwick tree.
+  long long total = 0;
+  std::vector<std::pair<int, int>> edges;
+  std::vector<int> tree;
+
+  for (size_t l = 0; l + 1 < layers.size(); l++) {
+    edges.clear();
+    for (int v : layers[l])
+      for (int w : this->vertices[v].down)
+        edges.push_back({pos[v], pos[w]});
+    std::sort(edges.begin(), edges.end());
+
+    size_t width = layers[l + 1].size();
+    tree.assign(width + 1, 0);
+    long long seen = 0;
+    for (const auto &edge : edges) {
+      // Edges so far ending strictly right of this one cross it.
+      long long notRight = 0;
+      for (int i = edge.second + 1; i > 0; i -= i & -i)
+        notRight += tree[i];
+      total += seen - notRight;
+
+      for (size_t i = edge.second + 1; i <= width; i += i & -i)
+        tree[i]++;
+      seen++;
+    }
+  }
+  return total;
+}
+
+void HierarchyLayout::place() {
+  for (const std::vector<int> &layer : this->layers) {
+    float x = 0;
+    for (size_t i = 0; i < layer.size(); i++) {
+      Vertex &v = this->vertices[layer[i]];
+      if (i > 0)
+        x += this->vertices[layer[i - 1]].radius + v.radius + nodeGap;
+      v.x = x;
+    }
+    float shift = x / 2;
+    for (int v : layer)
+      this->vertices[v].x -= shift;
+  }
+
+  for (int pass = 0; pass < placementPasses; pass++) {
+    bool down = pass % 2 == 0;
+    int count = static_cast<int>(this->layers.size());
+    for (int step = 1; step < count; step++)
+      this->fit(this->layers[down ? step : count - 1 - step], down);
+  }
+}
+
+void HierarchyLayout::fit(const std::vector<int> &layer, bool useUp) {
+  size_t n = layer.size();
+  if (n == 0)
+    return;
+
+  // Want each vertex at the mean of its neighbours on the fixed side, with
+  // at least the separation between consecutive vertices. Subtracting the
+  // cumulative separation turns that into fitting a non-decreasing
+  // sequence, which pool-adjacent-violators solves exactly.
+  std::vector<double> offset(n, 0);
+  std::vector<double> target(n);
+  for (size_t i = 0; i < n; i++) {
+    const Vertex &v = this->vertices[layer[i]];
+    if (i > 0)
+      offset[i] = offset[i - 1] + this->vertices[layer[i - 1]].radius +
+                  v.radius + nodeGap;
+
+    const std::vector<int> &adjacent = useUp ? v.up : v.down;
+    double want = v.x;
+    if (!adjacent.empty()) {
+      want = 0;
+      for (int u : adjacent)
+        want += this->vertices[u].x;
+      want /= adjacent.size();
+    }
+    target[i] = want - offset[i];
+  }
+
+  struct Block {
+    double sum;
+    size_t count;
+    double mean() const { return sum / count; }
+  };
+  std::vector<Block> blocks;
+  for (size_t i = 0; i < n; i++) {
+    blocks.push_back({target[i], 1});
+    while (blocks.size() > 1 &&
+           blocks[blocks.size() - 2].mean() > blocks.back().mean()) {
+      Block last = blocks.back();
+      blocks.pop_back();
+      blocks.back().sum += last.sum;
+      blocks.back().count += last.count;
+    }
+  }
+
+  size_t i = 0;
+  for (const Block &block : blocks)
+    for (size_t k = 0; k < block.count; k++, i++)
+      this->vertices[layer[i]].x = static_cast<float>(block.mean() + offset[i]);
+}
@@ -0,0 +1,53 @@
+#ifndef HIERARCHYLAYOUT_H
+#define HIERARCHYLAYOUT_H
+
+#include <cstdint>
+#include <vector>
+
+class Map;
+class Node;
+
+// One-shot layered (Sugiyama) layout of the DAG, top to bottom:
+//
+//   layers     longest path from the sources, walked in TopoOrder rank
+//   dummies    edges spanning several layers get a vertex per layer crossed
+//   ordering   barycenter sweeps, run as independent trials in parallel from
+//              different starting orders; the fewest crossings wins
+//   placement  each layer is fitted to its neighbours' positions by
+//              isotonic regression, keeping radius-based separation
+//
+// Every node moved records a Move, so the layout is one undo step.
+class HierarchyLayout {
+public:
+  // Lays out root and its descendants, keeping root where it is, or the
+  // whole map around its current centre when root is null.
+  static void apply(Map &map, Node *root);
+
+private:
+  struct Vertex {
+    Node *node;
+    float radius;
+    int layer;
+    float x;
+    std::vector<int> up;
+    std::vector<int> down;
+  };
+
+  using Layers = std::vector<std::vector<int>>;
+
+  explicit HierarchyLayout(Map &map) : map(map) {}
+
+  void build(const std::vector<uint32_t> &members, Node *root);
+  void order();
+  void sweep(Layers &layers, std::vector<int> &pos, bool down) const;
+  long long crossings(const Layers &layers,
+                      const std::vector<int> &pos) const;
+  void place();
+  void fit(const std::vector<int> &layer, bool useUp);
+
+  Map &map;
+  std::vector<Vertex> vertices;
+  Layers layers;
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include "history.h"
+#include "map.h"
+
+// Keystrokes further apart than this start a new undo step.
+static constexpr std::chrono::milliseconds typingBurst(1000);
+
+void History::record(const MapOp &op) {
+  if (this->applying)
+    return;
+
+  if (!this->redoSteps.empty()) {
+    for (const Step &step : this->redoSteps)
+      this->usage -= bytesFor(step);
+    this->redoSteps.clear();
+  }
+
+  if (!this->open.empty() && this->open.back().merge(op))
+    return;
+  this->open.push_back(op);
+}
+
+void History::commit() {
+  if (this->open.empty())
+    return;
+
+  auto now = std::chrono::steady_clock::now();
+  bool typing = this->open.size() == 1 && this->open[0].type == MapOp::SetText;
+
+  if (typing && !this->undoSteps.empty()) {
+    Step &last = this->undoSteps.back();
+    if (last.textNode == this->open[0].node && now - last.time < typingBurst) {
+      MapOp op = decode(last)[0];
+      op.merge(this->open[0]);
+
+      this->usage -= bytesFor(last);
+      last.ops.clear();
+      op.encode(last.ops, true);
+      last.ops.shrink_to_fit();
+      last.time = now;
+      this->usage += bytesFor(last);
+
+      this->open.clear();
+      this->evict();
+      return;
+    }
+  }
+
+  Step step;
+  for (const MapOp &op : this->open)
+    op.encode(step.ops, true);
+  step.ops.shrink_to_fit();
+  step.time = now;
+  if (typing)
+    step.textNode = this->open[0].node;
+  this->open.clear();
+
+  this->usage += bytesFor(step);
+  this->undoSteps.push_back(std::move(step));
+  this->evict();
+}
+
+bool History::undo(TTF_Font *font) {
+  this->commit();
+  if (this->undoSteps.empty())
+    return false;
+
+  Step step = std::move(this->undoSteps.back());
+  this->undoSteps.pop_back();
+
+  std::vector<MapOp> ops = decode(step);
+  this->applying = 1;
+  for (auto it = ops.rbegin(); it != ops.rend(); ++it)
+    Map::curMap->revert(*it, font);
+  this->applying = 0;
+
+  // A redone step must not swallow the next keystroke.
+  step.textNode = NodeId();
+  this->redoSteps.push_back(std::move(step));
+  return true;
+}
+
+bool History::redo(TTF_Font *font) {
+  this->commit();
+  if (this->redoSteps.empty())
+    return false;
+
+  Step step = std::move(this->redoSteps.back());
+  this->redoSteps.pop_back();
+
+  this->applying = 1;
+  for (const MapOp &op : decode(step))
+    Map::curMap->apply(op, font);
+  this->applying = 0;
+
+  this->undoSteps.push_back(std::move(step));
+  return true;
+}
+
+void History::clear() {
+  this->open.clear();
+  this->undoSteps.clear();
+  this->redoSteps.clear();
+  this->usage = 0;
+}
+
+void History::setMemoryBudget(size_t bytes) {
+  this->budget = bytes;
+  this->evict();
+}
+
+size_t History::getMemoryUsage() const { return this->usage; }
+
+std::vector<MapOp> History::decode(const Step &step) {
+  std::vector<MapOp> ops;
+  const char *at = step.ops.data();
+  const char *end = at + step.ops.size();
+  while (at < end) {
+    MapOp op;
+    if (!MapOp::decode(at, end, op, true))
+      break;
+    ops.push_back(std::move(op));
+  }
+  return ops;
+}
+
+size_t History::bytesFor(const Step &step) {
+  return sizeof(Step) + step.ops.capacity();
+}
+
+void History::evict() {
+  while (this->usage > this->budget && !this->undoSteps.empty()) {
+    this->usage -= bytesFor(this->undoSteps.front());
+    this->undoSteps.pop_front();
+  }
+}
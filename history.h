@@ -0,0 +1,51 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "mapop.h"
+#include <SDL2/SDL_ttf.h>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+// Undo/redo over the ops Map::record reports. Ops collect into an open
+// step until commit(); consecutive ops on the same node fold together, so a
+// drag is one Move and a typing burst one SetText. Committed steps are kept
+// MapOp-encoded with their before-state, and the oldest are dropped once
+// the stacks outgrow the memory budget.
+class History {
+public:
+  void record(const MapOp &op);
+  // Closes the open step. A lone SetText committed soon after another on
+  // the same node joins it, so keystrokes undo as one.
+  void commit();
+
+  bool undo(TTF_Font *font);
+  bool redo(TTF_Font *font);
+  void clear();
+
+  void setMemoryBudget(size_t bytes);
+  size_t getMemoryUsage() const;
+
+private:
+  struct Step {
+    std::vector<char> ops;
+    std::chrono::steady_clock::time_point time;
+    // Set when the step is a single SetText, for coalescing typing.
+    NodeId textNode;
+  };
+
+  static std::vector<MapOp> decode(const Step &step);
+  static size_t bytesFor(const Step &step);
+  void evict();
+
+  std::vector<MapOp> open;
+  std::deque<Step> undoSteps;
+  std::vector<Step> redoSteps;
+  bool applying = 0;
+
+  size_t budget = 1 << 20;
+  size_t usage = 0;
+};
+
+#endif
@@ -0,0 +1,223 @@
+#include "hud.h"
+#include <algorithm>
+#include <iostream>
+
+static constexpr int sliderSteps = 255;
+
+HudLabel::~HudLabel() {
+  if (this->texture)
+    SDL_DestroyTexture(this->texture);
+}
+
+void HudLabel::setText(const std::string &text) {
+  if (text == this->text)
+    return;
+
+  this->text = text;
+  this->dirty = 1;
+}
+
+void HudLabel::update(SDL_Renderer *renderer, TTF_Font *font) {
+  if (!this->dirty)
+    return;
+  this->dirty = 0;
+
+  if (this->texture)
+    SDL_DestroyTexture(this->texture);
+  this->texture = nullptr;
+  this->w = 0;
+  this->h = 0;
+  if (this->text.empty())
+    return;
+
+  SDL_Surface *surface = TTF_RenderText_Blended(font, this->text.c_str(),
+                                                SDL_Color{0, 0, 0, 255});
+  if (!surface) {
+    std::cout << "TTF_RenderText_Blended failed: " << TTF_GetError() << '\n';
+    return;
+  }
+
+  this->texture = SDL_CreateTextureFromSurface(renderer, surface);
+  this->w = surface->w;
+  this->h = surface->h;
+  SDL_FreeSurface(surface);
+
+  if (!this->texture)
+    std::cout << "SDL_CreateTextureFromSurface failed: " << SDL_GetError()
+              << '\n';
+}
+
+void HudLabel::render(SDL_Renderer *renderer, int x, int y) const {
+  if (!this->texture)
+    return;
+
+  SDL_Rect rect = {x, y, this->w, this->h};
+  SDL_RenderCopy(renderer, this->texture, nullptr, &rect);
+}
+
+int HudLabel::getWidth() const { return this->w; }
+int HudLabel::getHeight() const { return this->h; }
+
+Hud::Hud(SDL_Renderer *renderer, TTF_Font *font)
+    : renderer(renderer), font(font) {}
+
+Hud::~Hud() {
+  for (SDL_Texture *slider : this->sliders)
+    if (slider)
+      SDL_DestroyTexture(slider);
+}
+
+void Hud::setFilename(const std::string &filename) {
+  this->filename.setText(" File: " + filename + ".mind");
+}
+
+void Hud::setSaveStatus(const std::string &status) {
+  this->saveStatus.setText(status);
+}
+
+void Hud::setZoom(int percent) {
+  this->zoom.setText(std::to_string(percent) + "%");
+}
+
+void Hud::setSearch(const std::string &search) {
+  this->search.setText(search);
+}
+
+void Hud::setColor(const SDL_Color *color) {
+  this->showColor = color != nullptr;
+  if (!color)
+    return;
+
+  if (color->r != this->color.r || color->g != this->color.g ||
+      color->b != this->color.b)
+    this->slidersDirty = 1;
+
+  this->color = *color;
+}
+
+void Hud::setProfile(const std::vector<std::string> &lines) {
+  while (this->profile.size() < lines.size())
+    this->profile.push_back(std::make_unique<HudLabel>());
+  this->profile.resize(lines.size());
+
+  for (size_t i = 0; i < lines.size(); i++)
+    this->profile[i]->setText(lines[i]);
+}
+
+SDL_Rect Hud::getFilenameRect() const {
+  return {0, 0, this->filename.getWidth(), this->filename.getHeight()};
+}
+
+void Hud::rebuildSliders() {
+  this->slidersDirty = 0;
+
+  // Each slider is a one pixel wide gradient sweeping its own channel while
+  // holding the other two at the current colour, stretched when drawn.
+  Uint32 pixels[sliderSteps];
+  for (int channel = 0; channel < 3; channel++) {
+    if (!this->sliders[channel]) {
+      this->sliders[channel] =
+          SDL_CreateTexture(this->renderer, SDL_PIXELFORMAT_ARGB8888,
+                            SDL_TEXTUREACCESS_STATIC, 1, sliderSteps);
+      if (!this->sliders[channel]) {
+        std::cout << "SDL_CreateTexture failed: " << SDL_GetError() << '\n';
+        return;
+      }
+      SDL_SetTextureScaleMode(this->sliders[channel], SDL_ScaleModeNearest);
+    }
+
+    for (int row = 0; row < sliderSteps; row++) {
+      Uint32 i = sliderSteps - 1 - row;
+      Uint32 r = channel == 0 ? i : this->color.r;
+      Uint32 g = channel == 1 ? i : this->color.g;
+      Uint32 b = channel == 2 ? i : this->color.b;
+      pixels[row] = 0xFF000000 | (r << 16) | (g << 8) | b;
+    }
+
+    SDL_UpdateTexture(this->sliders[channel], nullptr, pixels, 4);
+  }
+}
+
+void Hud::render(int width, int height) {
+  this->filename.update(this->renderer, this->font);
+  this->saveStatus.update(this->renderer, this->font);
+  this->zoom.update(this->renderer, this->font);
+  this->search.update(this->renderer, this->font);
+
+  SDL_Rect rect = {0, 0, this->filename.getWidth() + 10,
+                   this->filename.getHeight()};
+  SDL_SetRenderDrawColor(this->renderer, 150, 200, 255, 255);
+  SDL_RenderFillRect(this->renderer, &rect);
+  SDL_SetRenderDrawColor(this->renderer, 0, 0, 0, 255);
+  SDL_RenderDrawRect(this->renderer, &rect);
+  this->filename.render(this->renderer, 0, 0);
+  this->saveStatus.render(this->renderer, rect.w + 10, 0);
+  int below = rect.h;
+
+  if (this->search.getWidth() > 0) {
+    rect = {0, below + 5, this->search.getWidth() + 10,
+            this->search.getHeight()};
+    SDL_SetRenderDrawColor(this->renderer, 255, 230, 150, 255);
+    SDL_RenderFillRect(this->renderer, &rect);
+    SDL_SetRenderDrawColor(this->renderer, 0, 0, 0, 255);
+    SDL_RenderDrawRect(this->renderer, &rect);
+    this->search.render(this->renderer, 0, rect.y);
+    below = rect.y + rect.h;
+  }
+
+  if (!this->profile.empty()) {
+    int panelWidth = 0;
+    int panelHeight = 0;
+    for (const auto &line : this->profile) {
+      line->update(this->renderer, this->font);
+      panelWidth = std::max(panelWidth, line->getWidth());
+      panelHeight += line->getHeight();
+    }
+
+    int y = below + 10;
+    rect = {0, y, panelWidth + 10, panelHeight + 10};
+    SDL_SetRenderDrawColor(this->renderer, 255, 255, 255, 220);
+    SDL_RenderFillRect(this->renderer, &rect);
+    SDL_SetRenderDrawColor(this->renderer, 0, 0, 0, 255);
+    SDL_RenderDrawRect(this->renderer, &rect);
+
+    y += 5;
+    for (const auto &line : this->profile) {
+      line->render(this->renderer, 5, y);
+      y += line->getHeight();
+    }
+  }
+
+  if (this->showColor) {
+    rect = {width - 140, 0, 140, 335};
+    SDL_SetRenderDrawColor(this->renderer, 255, 255, 255, 255);
+    SDL_RenderFillRect(this->renderer, &rect);
+    SDL_SetRenderDrawColor(this->renderer, 0, 0, 0, 255);
+    SDL_RenderDrawRect(this->renderer, &rect);
+
+    if (this->slidersDirty)
+      this->rebuildSliders();
+
+    for (int channel = 0; channel < 3; channel++) {
+      rect = {width - 120 + channel * 40, 275 - sliderSteps + 1, 20,
+              sliderSteps};
+      SDL_RenderCopy(this->renderer, this->sliders[channel], nullptr, &rect);
+    }
+
+    SDL_SetRenderDrawColor(this->renderer, 127, 127, 127, 255);
+
+    rect = {width - 120, 275 - this->color.r - 2, 20, 5};
+    SDL_RenderDrawRect(this->renderer, &rect);
+    rect = {width - 80, 275 - this->color.g - 2, 20, 5};
+    SDL_RenderDrawRect(this->renderer, &rect);
+    rect = {width - 40, 275 - this->color.b - 2, 20, 5};
+    SDL_RenderDrawRect(this->renderer, &rect);
+
+    rect = {width - 120, 295, 100, 20};
+    SDL_SetRenderDrawColor(this->renderer, this->color.r, this->color.g,
+                           this->color.b, this->color.a);
+    SDL_RenderFillRect(this->renderer, &rect);
+  }
+
+  this->zoom.render(this->renderer, 0, height - this->zoom.getHeight());
+}
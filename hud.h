@@ -0,0 +1,72 @@
+#ifndef HUD_H
+#define HUD_H
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A text widget that keeps its texture until the text changes.
+class HudLabel {
+public:
+  ~HudLabel();
+
+  void setText(const std::string &text);
+  void update(SDL_Renderer *renderer, TTF_Font *font);
+  void render(SDL_Renderer *renderer, int x, int y) const;
+
+  int getWidth() const;
+  int getHeight() const;
+
+private:
+
+  std::string text;
+  bool dirty = 1;
+
+  SDL_Texture *texture = nullptr;
+  int w = 0;
+  int h = 0;
+};
+
+// Retained overlay: the filename box, the save status, the search box, the
+// zoom readout, the profiler panel and the colour panel for the selected
+// node. Widgets only rebuild their textures when the value they show
+// changes.
+class Hud {
+public:
+  Hud(SDL_Renderer *renderer, TTF_Font *font);
+  ~Hud();
+
+  void setFilename(const std::string &filename);
+  void setSaveStatus(const std::string &status);
+  void setZoom(int percent);
+  // Text for the search box under the filename; empty hides it.
+  void setSearch(const std::string &search);
+  void setColor(const SDL_Color *color);
+  // Lines for the profiler panel; empty hides it.
+  void setProfile(const std::vector<std::string> &lines);
+
+  void render(int width, int height);
+
+  SDL_Rect getFilenameRect() const;
+
+private:
+  void rebuildSliders();
+
+  SDL_Renderer *renderer;
+  TTF_Font *font;
+
+  HudLabel filename;
+  HudLabel saveStatus;
+  HudLabel zoom;
+  HudLabel search;
+  std::vector<std::unique_ptr<HudLabel>> profile;
+
+  bool showColor = 0;
+  SDL_Color color = {0, 0, 0, 255};
+  bool slidersDirty = 1;
+  SDL_Texture *sliders[3] = {nullptr, nullptr, nullptr};
+};
+
+#endif
@@ -0,0 +1,1116 @@
+#include "importer.h"
+#include "map.h"
+#include "textlayout.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <utility>
+
+static constexpr size_t bufferSize = 1 << 16;
+
+// JSON nodes nest through "children"; deeper files are refused rather than
+// risking the stack.
+static constexpr int maxJsonDepth = 512;
+
+// Radius used when there is no font to measure labels with.
+static constexpr float defaultRadius = 50;
+
+// Space left between neighbouring subtrees and between layers.
+static constexpr float siblingGap = 20;
+static constexpr float layerGap = 80;
+
+// Top left of the imported map on screen.
+static constexpr float viewMargin = 40;
+
+static std::string lower(std::string text) {
+  for (char &c : text)
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  return text;
+}
+
+static std::string extension(const std::string &filename) {
+  size_t dot = filename.find_last_of('.');
+  size_t slash = filename.find_last_of('/');
+  if (dot == std::string::npos ||
+      (slash != std::string::npos && dot < slash))
+    return "";
+  return lower(filename.substr(dot));
+}
+
+// Code points that aren't characters, and NUL, which would cut labels short
+// in TTF's C string calls, become U+FFFD.
+static void appendUtf8(std::string &out, unsigned long cp) {
+  if (cp == 0 || (cp >= 0xD800 && cp < 0xE000) || cp > 0x10FFFF)
+    cp = 0xFFFD;
+
+  if (cp < 0x80) {
+    out += static_cast<char>(cp);
+  } else if (cp < 0x800) {
+    out += static_cast<char>(0xC0 | (cp >> 6));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  } else if (cp < 0x10000) {
+    out += static_cast<char>(0xE0 | (cp >> 12));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  } else {
+    out += static_cast<char>(0xF0 | (cp >> 18));
+    out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  }
+}
+
+// Accepts #rrggbb, which is what both Graphviz and most JSON exports use.
+static bool parseColor(const std::string &text, SDL_Color &color) {
+  if (text.size() != 7 || text[0] != '#' ||
+      !std::all_of(text.begin() + 1, text.end(), [](char c) {
+        return std::isxdigit(static_cast<unsigned char>(c));
+      }))
+    return false;
+
+  unsigned long rgb = std::strtoul(text.c_str() + 1, nullptr, 16);
+  color = {static_cast<Uint8>(rgb >> 16), static_cast<Uint8>(rgb >> 8),
+           static_cast<Uint8>(rgb), 255};
+  return true;
+}
+
+bool Importer::canImport(const std::string &filename) {
+  std::string ext = extension(filename);
+  return ext == ".opml" || ext == ".dot" || ext == ".gv" || ext == ".json";
+}
+
+bool Importer::load(Map &map, const std::string &filename, TTF_Font *font) {
+  Importer importer(map, filename, font);
+  if (!importer.in) {
+    std::cout << "Failed to open " << filename << '\n';
+    return false;
+  }
+
+  map.currentNode = NodeId();
+  map.journalSequence = 0;
+  map.nodes.clear();
+  map.order.clear();
+  map.index.clear();
+  map.search.clear();
+
+  std::string ext = extension(filename);
+  bool ok = ext == ".opml"   ? importer.readOpml()
+            : ext == ".json" ? importer.readJson()
+                             : importer.readDot();
+
+  // Nothing was checked before nodes went in, so a bad file can only be
+  // backed out of entirely.
+  if (!ok) {
+    map.nodes.clear();
+    map.order.clear();
+    return false;
+  }
+
+  importer.finish();
+  importer.place();
+  return true;
+}
+
+Importer::Importer(Map &map, const std::string &filename, TTF_Font *font)
+    : map(map), filename(filename), font(font),
+      in(filename, std::ios::binary), buffer(bufferSize) {}
+
+int Importer::peek() {
+  if (this->pos == this->end) {
+    this->in.read(this->buffer.data(), this->buffer.size());
+    this->end = static_cast<size_t>(this->in.gcount());
+    this->pos = 0;
+    if (this->end == 0)
+      return EOF;
+  }
+  return static_cast<unsigned char>(this->buffer[this->pos]);
+}
+
+int Importer::get() {
+  int c = this->peek();
+  if (c == EOF)
+    return EOF;
+  this->pos++;
+  if (c == '\n')
+    this->line++;
+  return c;
+}
+
+void Importer::skipSpace() {
+  while (std::isspace(this->peek()))
+    this->get();
+}
+
+bool Importer::skipPast(const std::string &end) {
+  std::string tail;
+  for (int c = this->get(); c != EOF; c = this->get()) {
+    tail += static_cast<char>(c);
+    if (tail.size() > end.size())
+      tail.erase(0, 1);
+    if (tail == end)
+      return true;
+  }
+  return false;
+}
+
+bool Importer::fail(const std::string &reason) {
+  std::cout << "Failed to import " << this->filename << ": line " << this->line
+            << ": " << reason << '\n';
+  return false;
+}
+
+Node *Importer::make(const std::string &text) {
+  Node *node = this->map.nodes.create(0, 0, this->font);
+  this->setLabel(node, text);
+  this->map.order.insert(node->id.index);
+  this->created.push_back(node);
+  return node;
+}
+
+Node *Importer::named(const std::string &key) {
+  auto it = this->names.find(key);
+  if (it != this->names.end())
+    return it->second;
+
+  // Nodes may be named by an edge before they're declared; they keep the
+  // name as label until then.
+  Node *node = this->make(key);
+  this->names.emplace(key, node);
+  return node;
+}
+
+void Importer::setLabel(Node *node, const std::string &text) {
+  // Labels are a single run of text; line breaks are the layout's job.
+  node->text = text;
+  for (char &c : node->text)
+    if (c == '\n' || c == '\r' || c == '\t')
+      c = ' ';
+}
+
+void Importer::link(Node *parent, Node *child) {
+  if (parent == child)
+    return;
+  parent->children.push_back(child->id.index);
+  child->parents.push_back(parent->id.index);
+}
+
+void Importer::finish() {
+  // Formats that repeat an edge get it once.
+  for (Node *node : this->created) {
+    for (std::vector<uint32_t> *list : {&node->parents, &node->children}) {
+      std::sort(list->begin(), list->end());
+      list->erase(std::unique(list->begin(), list->end()), list->end());
+    }
+  }
+
+  // Outlines can't have cycles but graphs can. Relinking edge by edge
+  // through the cycle check, as MindFile::load does, is far too slow at
+  // this size, so the edges closing them are found in one search instead.
+  if (!this->map.order.rebuild()) {
+    size_t dropped = this->breakCycles();
+    std::cout << "Dropped " << dropped << " edges of " << this->filename
+              << " that closed a cycle\n";
+    this->map.order.rebuild();
+  }
+
+  FontMetrics *metrics = this->font ? FontMetrics::get(this->font) : nullptr;
+  TextLayout layout;
+  for (Node *node : this->created) {
+    if (metrics) {
+      layout.reset(metrics, node->text);
+      node->radius = Node::radiusFor(layout);
+    } else {
+      node->radius = defaultRadius;
+    }
+  }
+}
+
+size_t Importer::breakCycles() {
+  // Depth-first search; an edge back to a node still on the stack closes a
+  // cycle, and with all of those gone none are left.
+  uint32_t slots = 0;
+  for (Node *node : this->created)
+    slots = std::max(slots, node->id.index + 1);
+
+  enum : uint8_t { unseen, onStack, done };
+  std::vector<uint8_t> state(slots, unseen);
+  std::vector<std::pair<uint32_t, size_t>> stack;
+  std::vector<std::pair<uint32_t, uint32_t>> back;
+
+  for (Node *root : this->created) {
+    if (state[root->id.index] != unseen)
+      continue;
+
+    state[root->id.index] = onStack;
+    stack.emplace_back(root->id.index, 0);
+    while (!stack.empty()) {
+      uint32_t index = stack.back().first;
+      size_t next = stack.back().second++;
+      const std::vector<uint32_t> &children =
+          this->map.nodes.at(index)->children;
+
+      if (next == children.size()) {
+        state[index] = done;
+        stack.pop_back();
+        continue;
+      }
+
+      uint32_t child = children[next];
+      if (state[child] == onStack) {
+        back.emplace_back(index, child);
+      } else if (state[child] == unseen) {
+        state[child] = onStack;
+        stack.emplace_back(child, 0);
+      }
+    }
+  }
+
+  auto erase = [](std::vector<uint32_t> &list, uint32_t index) {
+    list.erase(std::lower_bound(list.begin(), list.end(), index));
+  };
+  for (const auto &[parent, child] : back) {
+    erase(this->map.nodes.at(parent)->children, child);
+    erase(this->map.nodes.at(child)->parents, parent);
+  }
+  return back.size();
+}
+
+void Importer::place() {
+  // Each node hangs under its first parent, which makes a forest: following
+  // first parents upwards always ends at a node without any. Leaves are
+  // laid left to right in file order and parents centred over their
+  // children, but never left of where their own subtree starts.
+  uint32_t slots = 0;
+  for (Node *node : this->created)
+    slots = std::max(slots, node->id.index + 1);
+
+  std::vector<uint32_t> up(slots, NodeId::invalidIndex);
+  std::vector<int> depth(slots, 0);
+  std::vector<float> start(slots, 0);
+  for (Node *node : this->created)
+    if (!node->parents.empty())
+      up[node->id.index] = node->parents[0];
+
+  std::vector<float> rowRadius;
+  std::vector<std::pair<uint32_t, size_t>> stack;
+  float cursor = 0;
+  for (Node *root : this->created) {
+    if (!root->parents.empty())
+      continue;
+
+    stack.emplace_back(root->id.index, 0);
+    start[root->id.index] = cursor;
+    while (!stack.empty()) {
+      auto &[index, next] = stack.back();
+      Node *node = this->map.nodes.at(index);
+
+      while (next < node->children.size() &&
+             up[node->children[next]] != index)
+        next++;
+      if (next < node->children.size()) {
+        uint32_t child = node->children[next++];
+        depth[child] = depth[index] + 1;
+        start[child] = cursor;
+        stack.emplace_back(child, 0);
+        continue;
+      }
+
+      // Children are done: place this node over them.
+      float first = 0, last = 0;
+      bool any = false;
+      for (uint32_t child : node->children) {
+        if (up[child] != index)
+          continue;
+        last = this->map.nodes.at(child)->x;
+        if (!any)
+          first = last;
+        any = true;
+      }
+
+      float r = node->radius;
+      float x = any ? (first + last) / 2 : cursor + r;
+      node->x = std::max(x, start[index] + r);
+      cursor = std::max(cursor, node->x + r + siblingGap);
+
+      size_t row = static_cast<size_t>(depth[index]);
+      if (rowRadius.size() <= row)
+        rowRadius.resize(row + 1, 0);
+      rowRadius[row] = std::max(rowRadius[row], r);
+
+      stack.pop_back();
+    }
+  }
+
+  std::vector<float> rowY(rowRadius.size(), 0);
+  for (size_t row = 1; row < rowRadius.size(); row++)
+    rowY[row] = rowY[row - 1] + rowRadius[row - 1] + rowRadius[row] + layerGap;
+
+  for (Node *node : this->created) {
+    node->y = rowY[depth[node->id.index]];
+    node->updateIndex();
+  }
+  for (Node *node : this->created) {
+    for (uint32_t index : node->children) {
+      Node *child = this->map.nodes.at(index);
+      this->map.index.updateEdge(node, child, node->x, node->y, child->x,
+                                 child->y);
+    }
+  }
+
+  // Open on the top left corner, where the first root is.
+  this->map.dx = viewMargin;
+  this->map.dy = viewMargin;
+  if (!rowRadius.empty())
+    this->map.dy += rowRadius[0];
+}
+
+// OPML --------------------------------------------------------------------
+
+bool Importer::readOpml() {
+  // Outline elements opened and not yet closed, innermost last.
+  std::vector<Node *> open;
+  std::string name;
+  std::string attribute;
+  std::string text;
+  std::string title;
+
+  for (int c = this->get(); c != EOF; c = this->get()) {
+    if (c != '<')
+      continue;
+
+    c = this->peek();
+    if (c == '?') {
+      if (!this->skipPast("?>"))
+        return this->fail("unterminated processing instruction");
+      continue;
+    }
+    if (c == '!') {
+      this->get();
+      c = this->peek();
+      const char *end = c == '-' ? "-->" : c == '[' ? "]]>" : ">";
+      if (!this->skipPast(end))
+        return this->fail("unterminated comment or declaration");
+      continue;
+    }
+
+    bool closing = c == '/';
+    if (closing)
+      this->get();
+    if (!this->readXmlName(name))
+      return false;
+
+    if (closing) {
+      if (!this->skipPast(">"))
+        return this->fail("unterminated </" + name + ">");
+      if (name == "outline" && !open.empty())
+        open.pop_back();
+      continue;
+    }
+
+    bool outline = name == "outline";
+    bool hasText = false;
+    text.clear();
+    title.clear();
+
+    bool empty = false;
+    for (;;) {
+      this->skipSpace();
+      c = this->peek();
+      if (c == EOF)
+        return this->fail("unexpected end of file inside <" + name + ">");
+      if (c == '>') {
+        this->get();
+        break;
+      }
+      if (c == '/') {
+        this->get();
+        if (this->get() != '>')
+          return this->fail("expected > after / in <" + name + ">");
+        empty = true;
+        break;
+      }
+
+      if (!this->readXmlName(attribute))
+        return false;
+      this->skipSpace();
+      if (this->get() != '=')
+        return this->fail("expected = after " + attribute);
+      this->skipSpace();
+      int quote = this->get();
+      if (quote != '"' && quote != '\'')
+        return this->fail("expected a quoted value for " + attribute);
+
+      // Other attributes, notes especially, can be long; they're read past
+      // without being kept.
+      std::string *value = nullptr;
+      if (outline && attribute == "text") {
+        value = &text;
+        hasText = true;
+      } else if (outline && attribute == "title") {
+        value = &title;
+      }
+      if (!this->readXmlValue(quote, value))
+        return false;
+    }
+
+    if (!outline)
+      continue;
+
+    Node *node = this->make(hasText ? text : title);
+    if (!open.empty())
+      this->link(open.back(), node);
+    if (!empty)
+      open.push_back(node);
+  }
+
+  return true;
+}
+
+bool Importer::readXmlName(std::string &name) {
+  name.clear();
+  for (int c = this->peek(); c != EOF && !std::isspace(c) && c != '=' &&
+                             c != '>' && c != '/';
+       c = this->peek())
+    name += static_cast<char>(this->get());
+
+  if (name.empty())
+    return this->fail("expected a name");
+  return true;
+}
+
+bool Importer::readXmlValue(int quote, std::string *value) {
+  if (value)
+    value->clear();
+
+  for (int c = this->get(); c != quote; c = this->get()) {
+    if (c == EOF)
+      return this->fail("unterminated attribute value");
+    if (!value)
+      continue;
+    if (c != '&') {
+      *value += static_cast<char>(c);
+      continue;
+    }
+
+    std::string entity;
+    while (entity.size() < 10 && this->peek() != ';' && this->peek() != quote &&
+           this->peek() != EOF)
+      entity += static_cast<char>(this->get());
+    if (this->peek() != ';') {
+      // Not an entity after all; keep it as written.
+      *value += '&' + entity;
+      continue;
+    }
+    this->get();
+
+    if (entity == "amp")
+      *value += '&';
+    else if (entity == "lt")
+      *value += '<';
+    else if (entity == "gt")
+      *value += '>';
+    else if (entity == "quot")
+      *value += '"';
+    else if (entity == "apos")
+      *value += '\'';
+    else if (entity.size() > 1 && entity[0] == '#')
+      appendUtf8(*value,
+                 entity[1] == 'x' || entity[1] == 'X'
+                     ? std::strtoul(entity.c_str() + 2, nullptr, 16)
+                     : std::strtoul(entity.c_str() + 1, nullptr, 10));
+    else
+      *value += '&' + entity + ';';
+  }
+  return true;
+}
+
+// Graphviz DOT ------------------------------------------------------------
+
+bool Importer::readDot() {
+  Token token;
+  if (!this->next(token))
+    return false;
+  if (token.kind == 'i' && lower(token.text) == "strict" &&
+      !this->next(token))
+    return false;
+  if (token.kind != 'i' ||
+      (lower(token.text) != "graph" && lower(token.text) != "digraph"))
+    return this->fail("expected graph or digraph");
+
+  if (!this->next(token))
+    return false;
+  if ((token.kind == 'i' || token.kind == 'q') && !this->next(token))
+    return false;
+  if (token.kind != '{')
+    return this->fail("expected {");
+
+  // Subgraphs only group statements here, so they just nest.
+  int depth = 1;
+  while (depth > 0) {
+    if (!this->next(token))
+      return false;
+
+    switch (token.kind) {
+    case 0:
+      return this->fail("unexpected end of file");
+    case '{':
+      depth++;
+      continue;
+    case '}':
+      depth--;
+      continue;
+    case ';':
+    case ',':
+      continue;
+    case 'i':
+    case 'q':
+      break;
+    default:
+      return this->fail("unexpected " + token.text);
+    }
+
+    const Token *following = this->ahead();
+    if (!following)
+      return false;
+
+    std::string keyword = token.kind == 'i' ? lower(token.text) : "";
+    if (keyword == "subgraph") {
+      // Skip its name, if any; the body then opens like any group.
+      if ((following->kind == 'i' || following->kind == 'q') &&
+          !this->next(token))
+        return false;
+      if (!(following = this->ahead()))
+        return false;
+      if (following->kind != '{')
+        return this->fail("expected { after subgraph");
+      continue;
+    }
+    if ((keyword == "graph" || keyword == "node" || keyword == "edge") &&
+        following->kind == '[') {
+      if (!this->readDotAttributes(nullptr))
+        return false;
+      continue;
+    }
+    if (following->kind == '=') {
+      // Graph attribute, as in rankdir=LR.
+      if (!this->next(token) || !this->next(token))
+        return false;
+      if (token.kind != 'i' && token.kind != 'q')
+        return this->fail("expected a value after =");
+      continue;
+    }
+
+    Node *node = this->named(token.text);
+    if (!this->skipPort())
+      return false;
+
+    bool edge = false;
+    Node *from = node;
+    for (;;) {
+      if (!(following = this->ahead()))
+        return false;
+      if (following->kind != '>' && following->kind != '-')
+        break;
+
+      this->next(token);
+      if (!this->next(token))
+        return false;
+      if (token.kind == '{' || (token.kind == 'i' &&
+                                lower(token.text) == "subgraph"))
+        return this->fail("subgraphs as edge ends aren't supported");
+      if (token.kind != 'i' && token.kind != 'q')
+        return this->fail("expected a node after an edge");
+
+      // Undirected edges are taken left to right.
+      Node *to = this->named(token.text);
+      if (!this->skipPort())
+        return false;
+      this->link(from, to);
+      from = to;
+      edge = true;
+    }
+
+    // Attributes of an edge statement describe the edges, not the nodes.
+    if (following->kind == '[' &&
+        !this->readDotAttributes(edge ? nullptr : node))
+      return false;
+  }
+
+  return true;
+}
+
+bool Importer::next(Token &token) {
+  if (this->hasLookahead) {
+    token = std::move(this->lookahead);
+    this->hasLookahead = 0;
+    return true;
+  }
+  return this->lex(token);
+}
+
+const Importer::Token *Importer::ahead() {
+  if (!this->hasLookahead) {
+    if (!this->lex(this->lookahead))
+      return nullptr;
+    this->hasLookahead = 1;
+  }
+  return &this->lookahead;
+}
+
+bool Importer::lex(Token &token) {
+  token.text.clear();
+
+  for (;;) {
+    this->skipSpace();
+    int c = this->peek();
+    if (c == '#') {
+      // Preprocessor output lines.
+      while (this->peek() != EOF && this->peek() != '\n')
+        this->get();
+      continue;
+    }
+    if (c != '/')
+      break;
+
+    this->get();
+    if (this->peek() == '/') {
+      while (this->peek() != EOF && this->peek() != '\n')
+        this->get();
+    } else if (this->peek() == '*') {
+      this->get();
+      if (!this->skipPast("*/"))
+        return this->fail("unterminated comment");
+    } else {
+      return this->fail("unexpected /");
+    }
+  }
+
+  int c = this->peek();
+  if (c == EOF) {
+    token.kind = 0;
+    return true;
+  }
+
+  if (c == '"') {
+    this->get();
+    token.kind = 'q';
+    return this->readDotQuoted(token.text);
+  }
+  if (c == '<') {
+    this->get();
+    token.kind = 'q';
+    return this->readDotHtml(token.text);
+  }
+
+  if (c == '-') {
+    this->get();
+    int d = this->peek();
+    if (d == '>' || d == '-') {
+      this->get();
+      token.kind = static_cast<char>(d);
+      token.text = d == '>' ? "->" : "--";
+      return true;
+    }
+    token.text = "-";
+    return this->readDotId(token);
+  }
+
+  if (std::string("{}[];,=:").find(static_cast<char>(c)) !=
+      std::string::npos) {
+    token.kind = static_cast<char>(this->get());
+    token.text = std::string(1, token.kind);
+    return true;
+  }
+
+  return this->readDotId(token);
+}
+
+bool Importer::readDotId(Token &token) {
+  // Names and numerals; anything beyond ASCII counts as a letter.
+  token.kind = 'i';
+  for (int c = this->peek(); c != EOF && (std::isalnum(c) || c == '_' ||
+                                          c == '.' || c >= 0x80);
+       c = this->peek())
+    token.text += static_cast<char>(this->get());
+
+  if (token.text.empty() || token.text == "-")
+    return this->fail(std::string("unexpected ") +
+                      static_cast<char>(this->peek()));
+  return true;
+}
+
+bool Importer::readDotQuoted(std::string &text) {
+  for (int c = this->get(); c != '"'; c = this->get()) {
+    if (c == EOF)
+      return this->fail("unterminated string");
+    if (c != '\\') {
+      text += static_cast<char>(c);
+      continue;
+    }
+
+    c = this->get();
+    if (c == EOF)
+      return this->fail("unterminated string");
+    if (c == '\n')
+      continue;
+    // Graphviz's line breaks: centred, left and right justified.
+    if (c == 'n' || c == 'l' || c == 'r')
+      text += ' ';
+    else if (c == '"' || c == '\\')
+      text += static_cast<char>(c);
+    else
+      text += '\\', text += static_cast<char>(c);
+  }
+  return true;
+}
+
+bool Importer::readDotHtml(std::string &text) {
+  // Keep the text of an HTML-like label and drop its markup.
+  int depth = 1;
+  while (depth > 0) {
+    int c = this->get();
+    if (c == EOF)
+      return this->fail("unterminated HTML label");
+    if (c == '<')
+      depth++;
+    else if (c == '>')
+      depth--;
+    else if (depth == 1)
+      text += static_cast<char>(c);
+  }
+  return true;
+}
+
+bool Importer::skipPort() {
+  Token token;
+  for (;;) {
+    const Token *following = this->ahead();
+    if (!following)
+      return false;
+    if (following->kind != ':')
+      return true;
+
+    this->next(token);
+    if (!this->next(token))
+      return false;
+    if (token.kind != 'i' && token.kind != 'q')
+      return this->fail("expected a port after :");
+  }
+}
+
+bool Importer::readDotAttributes(Node *node) {
+  Token token;
+  Token key;
+  for (;;) {
+    const Token *following = this->ahead();
+    if (!following)
+      return false;
+    if (following->kind != '[')
+      return true;
+    this->next(token);
+
+    for (;;) {
+      if (!this->next(key))
+        return false;
+      if (key.kind == ']')
+        break;
+      if (key.kind == ';' || key.kind == ',')
+        continue;
+      if (key.kind != 'i' && key.kind != 'q')
+        return this->fail("expected an attribute name");
+
+      if (!this->next(token))
+        return false;
+      if (token.kind != '=')
+        return this->fail("expected = after " + key.text);
+      if (!this->next(token))
+        return false;
+      if (token.kind != 'i' && token.kind != 'q')
+        return this->fail("expected a value for " + key.text);
+
+      if (!node)
+        continue;
+      SDL_Color color;
+      if (key.text == "label")
+        this->setLabel(node, token.text);
+      else if (key.text == "fillcolor" && parseColor(token.text, color))
+        node->bgColor = color;
+      else if (key.text == "fontcolor" && parseColor(token.text, color))
+        node->textColor = color;
+    }
+  }
+}
+
+// JSON --------------------------------------------------------------------
+
+template <class F> bool Importer::readJsonObject(F member) {
+  this->skipSpace();
+  if (this->get() != '{')
+    return this->fail("expected an object");
+
+  this->skipSpace();
+  if (this->peek() == '}') {
+    this->get();
+    return true;
+  }
+
+  std::string key;
+  for (;;) {
+    this->skipSpace();
+    if (!this->readJsonString(key))
+      return false;
+    this->skipSpace();
+    if (this->get() != ':')
+      return this->fail("expected : after \"" + key + "\"");
+    this->skipSpace();
+    if (!member(key))
+      return false;
+
+    this->skipSpace();
+    int c = this->get();
+    if (c == '}')
+      return true;
+    if (c != ',')
+      return this->fail("expected , or } in an object");
+  }
+}
+
+template <class F> bool Importer::readJsonArray(F element) {
+  this->skipSpace();
+  if (this->get() != '[')
+    return this->fail("expected an array");
+
+  this->skipSpace();
+  if (this->peek() == ']') {
+    this->get();
+    return true;
+  }
+
+  for (;;) {
+    this->skipSpace();
+    if (!element())
+      return false;
+
+    this->skipSpace();
+    int c = this->get();
+    if (c == ']')
+      return true;
+    if (c != ',')
+      return this->fail("expected , or ] in an array");
+  }
+}
+
+bool Importer::readJson() {
+  Node *node;
+  auto readNodes = [&] {
+    return this->readJsonArray([&] { return this->readJsonNode(0, node); });
+  };
+
+  this->skipSpace();
+  bool ok = this->peek() == '['
+                ? readNodes()
+                : this->readJsonObject([&](const std::string &key) {
+                    if (key == "nodes")
+                      return readNodes();
+                    if (key == "edges")
+                      return this->readJsonArray(
+                          [&] { return this->readJsonEdge(); });
+                    return this->skipJsonValue(0);
+                  });
+  if (!ok)
+    return false;
+
+  this->skipSpace();
+  if (this->peek() != EOF)
+    return this->fail("unexpected text after the end");
+  return true;
+}
+
+bool Importer::readJsonNode(int depth, Node *&node) {
+  if (depth > maxJsonDepth)
+    return this->fail("children nested too deeply");
+
+  std::string id;
+  std::string label;
+  std::string color;
+  bool hasId = false;
+  bool hasLabel = false;
+  // Made before their parent, which only exists once its object closes.
+  std::vector<Node *> children;
+
+  bool ok = this->readJsonObject([&](const std::string &key) {
+    if (key == "id") {
+      hasId = true;
+      return this->readJsonKey(id);
+    }
+    if (key == "label" || key == "text") {
+      hasLabel = true;
+      return this->readJsonString(label);
+    }
+    if (key == "color")
+      return this->readJsonString(color);
+    if (key == "children")
+      return this->readJsonArray([&] {
+        Node *child;
+        if (!this->readJsonNode(depth + 1, child))
+          return false;
+        children.push_back(child);
+        return true;
+      });
+    return this->skipJsonValue(depth + 1);
+  });
+  if (!ok)
+    return false;
+
+  node = hasId ? this->named(id) : this->make("");
+  if (hasLabel)
+    this->setLabel(node, label);
+  SDL_Color bg;
+  if (parseColor(color, bg))
+    node->bgColor = bg;
+  for (Node *child : children)
+    this->link(node, child);
+  return true;
+}
+
+bool Importer::readJsonEdge() {
+  std::string from;
+  std::string to;
+  bool hasFrom = false;
+  bool hasTo = false;
+
+  bool ok = this->readJsonObject([&](const std::string &key) {
+    if (key == "from" || key == "source") {
+      hasFrom = true;
+      return this->readJsonKey(from);
+    }
+    if (key == "to" || key == "target") {
+      hasTo = true;
+      return this->readJsonKey(to);
+    }
+    return this->skipJsonValue(1);
+  });
+  if (!ok)
+    return false;
+  if (!hasFrom || !hasTo)
+    return this->fail("edge without both from and to");
+
+  this->link(this->named(from), this->named(to));
+  return true;
+}
+
+bool Importer::readJsonString(std::string &out) {
+  out.clear();
+  if (this->get() != '"')
+    return this->fail("expected a string");
+
+  auto hex4 = [&](uint32_t &cp) {
+    cp = 0;
+    for (int i = 0; i < 4; i++) {
+      int c = this->get();
+      if (!std::isxdigit(c))
+        return this->fail("bad \\u escape");
+      cp = cp * 16 + (std::isdigit(c) ? c - '0' : std::tolower(c) - 'a' + 10);
+    }
+    return true;
+  };
+
+  for (int c = this->get(); c != '"'; c = this->get()) {
+    if (c == EOF)
+      return this->fail("unterminated string");
+    if (c != '\\') {
+      out += static_cast<char>(c);
+      continue;
+    }
+
+    c = this->get();
+    switch (c) {
+    case 'b':
+      out += '\b';
+      break;
+    case 'f':
+      out += '\f';
+      break;
+    case 'n':
+      out += '\n';
+      break;
+    case 'r':
+      out += '\r';
+      break;
+    case 't':
+      out += '\t';
+      break;
+    case 'u': {
+      uint32_t cp;
+      if (!hex4(cp))
+        return false;
+      if (cp >= 0xD800 && cp < 0xDC00 && this->peek() == '\\') {
+        this->get();
+        uint32_t low;
+        if (this->get() != 'u' || !hex4(low))
+          return this->fail("bad surrogate pair");
+        if (low >= 0xDC00 && low < 0xE000) {
+          cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        } else {
+          // A lone high surrogate; the escape after it still counts.
+          appendUtf8(out, cp);
+          cp = low;
+        }
+      }
+      appendUtf8(out, cp);
+      break;
+    }
+    case EOF:
+      return this->fail("unterminated string");
+    default:
+      out += static_cast<char>(c);
+    }
+  }
+  return true;
+}
+
+bool Importer::readJsonKey(std::string &out) {
+  // Ids may be strings or numbers; numbers are kept as written.
+  if (this->peek() == '"')
+    return this->readJsonString(out);
+
+  out.clear();
+  for (int c = this->peek(); c != EOF && (std::isdigit(c) || c == '-' ||
+                                          c == '+' || c == '.' ||
+                                          c == 'e' || c == 'E');
+       c = this->peek())
+    out += static_cast<char>(this->get());
+
+  if (out.empty())
+    return this->fail("expected a string or number id");
+  return true;
+}
+
+bool Importer::skipJsonValue(int depth) {
+  if (depth > maxJsonDepth)
+    return this->fail("nested too deeply");
+
+  int c = this->peek();
+  if (c == '{')
+    return this->readJsonObject(
+        [&](const std::string &) { return this->skipJsonValue(depth + 1); });
+  if (c == '[')
+    return this->readJsonArray([&] { return this->skipJsonValue(depth + 1); });
+  if (c == '"') {
+    std::string ignored;
+    return this->readJsonString(ignored);
+  }
+
+  // Numbers, true, false and null.
+  bool any = false;
+  for (c = this->peek(); c != EOF && (std::isalnum(c) || c == '-' ||
+                                      c == '+' || c == '.');
+       c = this->peek()) {
+    this->get();
+    any = true;
+  }
+  if (!any)
+    return this->fail("expected a value");
+  return true;
+}
@@ -0,0 +1,101 @@
+#ifndef IMPORTER_H
+#define IMPORTER_H
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Map;
+class Node;
+
+// Reads maps made in other tools, picking the format from the extension:
+//
+//   .opml        outline elements, nested into a tree, labelled by their
+//                text (or title) attribute
+//   .dot, .gv    Graphviz graphs: node and edge statements, chained edges,
+//                subgraphs as plain groups, label and fillcolor attributes
+//   .json        {"nodes": [...], "edges": [...]}, a node being
+//                {"id", "label", "color", "children": [nodes...]} and an edge
+//                {"from", "to"}; a bare array is read as the node list
+//
+// Files are parsed in one pass through a fixed-size buffer, so memory goes
+// to the map being built rather than the file. Nodes are made straight in
+// the store and their edges linked in bulk, as MindFile::load does, without
+// recording anything; then each node is laid out under its first parent as
+// a tree, every other edge crossing between branches.
+class Importer {
+public:
+  static bool canImport(const std::string &filename);
+  // Replaces the map's contents, leaving it empty if the file is malformed.
+  // The map must be Map::curMap.
+  static bool load(Map &map, const std::string &filename, TTF_Font *font);
+
+private:
+  struct Token {
+    // 'i' bare id, 'q' quoted id, '>' or '-' for -> and --, 0 at the end,
+    // otherwise the punctuation character itself.
+    char kind = 0;
+    std::string text;
+  };
+
+  Importer(Map &map, const std::string &filename, TTF_Font *font);
+
+  int peek();
+  int get();
+  void skipSpace();
+  bool skipPast(const std::string &end);
+  bool fail(const std::string &reason);
+
+  Node *make(const std::string &text);
+  Node *named(const std::string &key);
+  void setLabel(Node *node, const std::string &text);
+  void link(Node *parent, Node *child);
+  void finish();
+  size_t breakCycles();
+  void place();
+
+  bool readOpml();
+  bool readXmlName(std::string &name);
+  bool readXmlValue(int quote, std::string *value);
+
+  bool readDot();
+  bool lex(Token &token);
+  bool next(Token &token);
+  const Token *ahead();
+  bool readDotId(Token &token);
+  bool readDotQuoted(std::string &text);
+  bool readDotHtml(std::string &text);
+  bool skipPort();
+  bool readDotAttributes(Node *node);
+
+  bool readJson();
+  template <class F> bool readJsonObject(F member);
+  template <class F> bool readJsonArray(F element);
+  bool readJsonNode(int depth, Node *&node);
+  bool readJsonEdge();
+  bool readJsonString(std::string &out);
+  bool readJsonKey(std::string &out);
+  bool skipJsonValue(int depth);
+
+  Map &map;
+  std::string filename;
+  TTF_Font *font;
+
+  std::ifstream in;
+  std::vector<char> buffer;
+  size_t pos = 0;
+  size_t end = 0;
+  size_t line = 1;
+
+  Token lookahead;
+  bool hasLookahead = 0;
+
+  std::vector<Node *> created;
+  std::unordered_map<std::string, Node *> names;
+};
+
+#endif
@@ -0,0 +1,363 @@
+#include "journal.h"
+#include "map.h"
+#include "mapsaver.h"
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Journal file layout, little-endian like the .mind tables:
+//
+//   "MJNL" version
+//   record*   size, checksum, sequence, then `size` payload bytes
+//
+// The checksum covers the sequence and payload, so a record torn by a crash
+// ends replay instead of being applied half written.
+static const char journalMagic[4] = {'M', 'J', 'N', 'L'};
+// Version 2 added SetPinned, version 3 SetTxtColor and SetCenteredText.
+static constexpr uint32_t journalVersion = 3;
+static constexpr size_t fileHeaderSize = 8;
+static constexpr size_t recordHeaderSize = 16;
+
+// How long edits may sit in memory before a group commit, and how much may
+// pile up before one is forced early.
+static constexpr std::chrono::milliseconds commitInterval(100);
+static constexpr size_t flushBytes = 1 << 20;
+
+// Log size that triggers a background checkpoint.
+static constexpr size_t compactBytes = 4 << 20;
+
+static uint32_t checksum(const char *data, size_t size) {
+  // FNV-1a; only has to catch torn writes, not tampering.
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static void encode(std::vector<char> &out, const MapOp &op, uint64_t sequence) {
+  size_t start = out.size();
+  out.resize(start + recordHeaderSize);
+  op.encode(out, false);
+
+  uint32_t size = static_cast<uint32_t>(out.size() - start - recordHeaderSize);
+  char *header = out.data() + start;
+  std::memcpy(header, &size, 4);
+  std::memcpy(header + 8, &sequence, 8);
+  uint32_t sum = checksum(header + 8, 8 + size);
+  std::memcpy(header + 4, &sum, 4);
+}
+
+static bool writeAll(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    ssize_t n = write(fd, data, size);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    data += n;
+    size -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+static int openLog(const std::string &path, bool truncate) {
+  int fd = open(path.c_str(),
+                O_WRONLY | O_CREAT | O_APPEND | (truncate ? O_TRUNC : 0), 0644);
+  if (fd < 0) {
+    std::cout << "Failed to open journal " << path << ": " << strerror(errno)
+              << '\n';
+    return -1;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size == 0) {
+    char header[fileHeaderSize];
+    std::memcpy(header, journalMagic, 4);
+    std::memcpy(header + 4, &journalVersion, 4);
+    writeAll(fd, header, sizeof(header));
+  }
+  return fd;
+}
+
+Journal::Journal() : worker(&Journal::run, this) {}
+
+Journal::~Journal() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = 1;
+  }
+  this->wake.notify_one();
+  this->worker.join();
+}
+
+void Journal::attach(const std::string &mapFile, bool fresh) {
+  this->mapFile = mapFile;
+  Map::curMap->journal = this;
+
+  Command command{Command::Open, mapFile};
+  command.sequence = Map::curMap->journalSequence;
+  command.fresh = fresh;
+  this->push(std::move(command));
+}
+
+void Journal::detach() {
+  if (Map::curMap->journal == this)
+    Map::curMap->journal = nullptr;
+  this->mapFile.clear();
+  this->push({Command::Close});
+}
+
+const std::string &Journal::getMapFile() const { return this->mapFile; }
+
+void Journal::append(const MapOp &op, uint64_t sequence) {
+  bool full;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    encode(this->buffer, op, sequence);
+    full = this->buffer.size() >= flushBytes;
+  }
+  if (full)
+    this->wake.notify_one();
+}
+
+bool Journal::needsCompaction() const {
+  return !this->mapFile.empty() && this->checkpoints == 0 &&
+         this->logBytes >= this->rotateFailedAt + compactBytes;
+}
+
+void Journal::checkpoint(MapSaver &saver) {
+  if (this->mapFile.empty())
+    return;
+
+  uint64_t sequence = Map::curMap->journalSequence;
+  std::string file = this->mapFile;
+
+  Command rotate{Command::Rotate, file};
+  rotate.sequence = sequence;
+  this->push(std::move(rotate));
+
+  this->checkpoints++;
+  saver.save(*Map::curMap, file, [this, file, sequence](bool ok) {
+    Command retire{Command::Retire, file};
+    retire.sequence = sequence;
+    retire.saved = ok;
+    this->push(std::move(retire));
+  });
+}
+
+void Journal::push(Command command) {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    // Records buffered so far belong before the command.
+    if (!this->buffer.empty()) {
+      this->queue.push_back({Command::Write});
+      this->queue.back().bytes.swap(this->buffer);
+    }
+    this->queue.push_back(std::move(command));
+  }
+  this->wake.notify_one();
+}
+
+void Journal::run() {
+  std::unique_lock<std::mutex> lock(this->mutex);
+  for (;;) {
+    this->wake.wait_for(lock, commitInterval, [this] {
+      return this->stopping || !this->queue.empty() ||
+             this->buffer.size() >= flushBytes;
+    });
+
+    if (!this->buffer.empty()) {
+      this->queue.push_back({Command::Write});
+      this->queue.back().bytes.swap(this->buffer);
+    }
+
+    std::vector<Command> batch;
+    batch.swap(this->queue);
+    bool stop = this->stopping;
+    lock.unlock();
+
+    for (Command &command : batch)
+      this->execute(command);
+    this->sync();
+
+    lock.lock();
+    if (stop && this->queue.empty() && this->buffer.empty())
+      break;
+  }
+
+  lock.unlock();
+  if (this->fd >= 0)
+    close(this->fd);
+}
+
+void Journal::execute(Command &command) {
+  switch (command.type) {
+  case Command::Open: {
+    this->sync();
+    if (this->fd >= 0)
+      close(this->fd);
+
+    this->path = command.path + ".journal";
+    std::string old = this->path + ".old";
+    if (command.fresh)
+      unlink(old.c_str());
+
+    this->fd = openLog(this->path, command.fresh);
+    this->hasOld = access(old.c_str(), F_OK) == 0;
+    // Everything in a leftover old log predates this point.
+    this->oldSequence = command.sequence;
+    this->rotateFailedAt = 0;
+
+    struct stat st;
+    this->logBytes = this->fd >= 0 && fstat(this->fd, &st) == 0
+                         ? static_cast<size_t>(st.st_size)
+                         : 0;
+    break;
+  }
+
+  case Command::Write:
+    if (this->fd < 0)
+      break;
+    if (!writeAll(this->fd, command.bytes.data(), command.bytes.size())) {
+      std::cout << "Failed to write journal " << this->path << ": "
+                << strerror(errno) << '\n';
+      break;
+    }
+    this->unsynced = 1;
+    this->logBytes += command.bytes.size();
+    break;
+
+  case Command::Rotate: {
+    if (this->fd < 0 || command.path + ".journal" != this->path)
+      break;
+    // An old log still waiting on its snapshot keeps its place; this
+    // checkpoint's snapshot will cover both, and the current log waits
+    // for a later one.
+    if (this->hasOld) {
+      this->rotateFailedAt = this->logBytes.load();
+      break;
+    }
+
+    this->sync();
+    close(this->fd);
+
+    std::string old = this->path + ".old";
+    if (rename(this->path.c_str(), old.c_str()) != 0) {
+      std::cout << "Failed to rotate journal " << this->path << ": "
+                << strerror(errno) << '\n';
+      this->fd = openLog(this->path, false);
+      this->rotateFailedAt = this->logBytes.load();
+      break;
+    }
+
+    this->hasOld = 1;
+    this->oldSequence = command.sequence;
+    this->fd = openLog(this->path, true);
+    this->logBytes = fileHeaderSize;
+    this->rotateFailedAt = 0;
+    break;
+  }
+
+  case Command::Retire:
+    this->checkpoints--;
+    if (command.saved && this->hasOld &&
+        command.path + ".journal" == this->path &&
+        this->oldSequence <= command.sequence) {
+      unlink((this->path + ".old").c_str());
+      this->hasOld = 0;
+    }
+    break;
+
+  case Command::Close:
+    this->sync();
+    if (this->fd >= 0)
+      close(this->fd);
+    this->fd = -1;
+    this->path.clear();
+    break;
+  }
+}
+
+void Journal::sync() {
+  if (!this->unsynced || this->fd < 0)
+    return;
+
+  if (fdatasync(this->fd) != 0)
+    std::cout << "fdatasync failed for " << this->path << ": "
+              << strerror(errno) << '\n';
+  this->unsynced = 0;
+}
+
+void Journal::replay(const std::string &mapFile, TTF_Font *font) {
+  Map &map = *Map::curMap;
+  std::string current = mapFile + ".journal";
+
+  for (const std::string &path : {current + ".old", current}) {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs)
+      continue;
+
+    std::vector<char> data((std::istreambuf_iterator<char>(ifs)),
+                           std::istreambuf_iterator<char>());
+    if (data.size() < fileHeaderSize ||
+        std::memcmp(data.data(), journalMagic, 4) != 0) {
+      std::cout << "Ignoring " << path << ": not a journal\n";
+      continue;
+    }
+
+    uint32_t version;
+    std::memcpy(&version, data.data() + 4, 4);
+    if (version > journalVersion) {
+      std::cout << "Ignoring " << path << ": written by a newer version\n";
+      continue;
+    }
+
+    size_t at = fileHeaderSize;
+    size_t applied = 0;
+    while (data.size() - at >= recordHeaderSize) {
+      uint32_t size, sum;
+      uint64_t sequence;
+      std::memcpy(&size, data.data() + at, 4);
+      std::memcpy(&sum, data.data() + at + 4, 4);
+      std::memcpy(&sequence, data.data() + at + 8, 8);
+
+      if (data.size() - at - recordHeaderSize < size ||
+          checksum(data.data() + at + 8, 8 + size) != sum)
+        break;
+
+      const char *payload = data.data() + at + recordHeaderSize;
+      at += recordHeaderSize + size;
+
+      if (sequence <= map.journalSequence)
+        continue;
+
+      MapOp op;
+      if (MapOp::decode(payload, payload + size, op, false) &&
+          map.apply(op, font))
+        applied++;
+      map.journalSequence = sequence;
+    }
+
+    // Cut a torn tail off the live log so records appended after it stay
+    // reachable.
+    if (at < data.size() && path == current) {
+      std::cout << "Dropping " << data.size() - at
+                << " torn bytes from " << path << '\n';
+      if (truncate(path.c_str(), static_cast<off_t>(at)) != 0)
+        std::cout << "truncate failed for " << path << ": "
+                  << strerror(errno) << '\n';
+    }
+
+    if (applied > 0)
+      std::cout << "Replayed " << applied << " operations from " << path
+                << '\n';
+  }
+}
@@ -0,0 +1,93 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "mapop.h"
+#include <SDL2/SDL_ttf.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Map;
+class MapSaver;
+
+// Append-only log of map operations kept beside the .mind file as
+// <name>.mind.journal. Records are buffered on the UI thread and written
+// by a worker that syncs once per batch, so a burst of edits costs one
+// fsync. On open the log is replayed over the snapshot, skipping records
+// the snapshot already contains.
+//
+// A checkpoint moves the log aside to <name>.mind.journal.old, writes a
+// fresh snapshot through MapSaver and deletes the old log once that
+// snapshot is on disk. Until then both logs are replayed.
+class Journal {
+public:
+  Journal();
+  Journal(const Journal &) = delete;
+  Journal &operator=(const Journal &) = delete;
+  // Writes out and syncs anything still buffered.
+  ~Journal();
+
+  // Starts logging Map::curMap to mapFile's journal. A fresh journal drops
+  // any log already there, for when the map is saved under a new name.
+  void attach(const std::string &mapFile, bool fresh);
+  void detach();
+  const std::string &getMapFile() const;
+
+  void append(const MapOp &op, uint64_t sequence);
+
+  // True once the log has grown enough that a checkpoint is worth it.
+  bool needsCompaction() const;
+  void checkpoint(MapSaver &saver);
+
+  // Applies mapFile's journals to Map::curMap. Run with no journal
+  // attached, straight after loading the snapshot.
+  static void replay(const std::string &mapFile, TTF_Font *font);
+
+private:
+  struct Command {
+    enum Type { Open, Write, Rotate, Retire, Close };
+
+    Type type;
+    std::string path;
+    std::vector<char> bytes;
+    uint64_t sequence = 0;
+    bool fresh = 0;
+    bool saved = 0;
+  };
+
+  void push(Command command);
+  void run();
+  void execute(Command &command);
+  void sync();
+
+  std::string mapFile;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::vector<Command> queue;
+  std::vector<char> buffer;
+  bool stopping = 0;
+
+  std::atomic<size_t> logBytes{0};
+  // Log size at a failed rotation; the next checkpoint waits for the log
+  // to grow by a full compaction's worth past it.
+  std::atomic<size_t> rotateFailedAt{0};
+  std::atomic<int> checkpoints{0};
+
+  // Worker state.
+  int fd = -1;
+  std::string path;
+  bool unsynced = 0;
+  bool hasOld = 0;
+  uint64_t oldSequence = 0;
+
+  // Last, so it starts after everything run touches.
+  std::thread worker;
+};
+
+#endif
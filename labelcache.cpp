@@ -0,0 +1,66 @@
+#include "labelcache.h"
+
+std::shared_ptr<const TextLayout> LabelCache::get(TTF_Font *font,
+                                                  const std::string &text) {
+  auto it = lookup.find({font, text});
+  if (it != lookup.end()) {
+    entries.splice(entries.begin(), entries, it->second);
+    return it->second->layout;
+  }
+
+  auto layout = std::make_shared<TextLayout>();
+  layout->reset(FontMetrics::get(font), text);
+  return put(font, text, std::move(layout));
+}
+
+std::shared_ptr<const TextLayout>
+LabelCache::put(TTF_Font *font, const std::string &text,
+                std::shared_ptr<const TextLayout> layout) {
+  Key key{font, text};
+
+  // Another node already holds this label; share its copy.
+  auto it = lookup.find(key);
+  if (it != lookup.end()) {
+    entries.splice(entries.begin(), entries, it->second);
+    return it->second->layout;
+  }
+
+  size_t bytes = bytesFor(key, *layout);
+  entries.push_front({key, std::move(layout), bytes});
+  lookup.emplace(std::move(key), entries.begin());
+  usage += bytes;
+
+  // The entry just added is returned as a strong reference, so it stays
+  // alive for the caller even if the budget pushes it straight back out.
+  std::shared_ptr<const TextLayout> result = entries.front().layout;
+  evict();
+  return result;
+}
+
+void LabelCache::setMemoryBudget(size_t bytes) {
+  budget = bytes;
+  evict();
+}
+
+size_t LabelCache::getMemoryUsage() { return usage; }
+
+void LabelCache::clear() {
+  lookup.clear();
+  entries.clear();
+  usage = 0;
+}
+
+size_t LabelCache::bytesFor(const Key &key, const TextLayout &layout) {
+  return sizeof(Entry) + sizeof(TextLayout) + key.text.capacity() +
+         layout.getLines().capacity() * sizeof(TextLayout::Line) +
+         4 * sizeof(void *);
+}
+
+void LabelCache::evict() {
+  while (usage > budget && !entries.empty()) {
+    Entry &last = entries.back();
+    usage -= last.bytes;
+    lookup.erase(last.key);
+    entries.pop_back();
+  }
+}
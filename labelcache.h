@@ -0,0 +1,62 @@
+#ifndef LABELCACHE_H
+#define LABELCACHE_H
+
+#include <SDL2/SDL_ttf.h>
+#include "textlayout.h"
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// Laid-out node labels shared by (font, text). Nodes only hold weak
+// references, so entries evicted under the memory budget are freed and
+// rebuilt the next time a node using them is drawn. Least recently used
+// entries go first.
+class LabelCache {
+public:
+  static std::shared_ptr<const TextLayout> get(TTF_Font *font,
+                                               const std::string &text);
+  static std::shared_ptr<const TextLayout>
+  put(TTF_Font *font, const std::string &text,
+      std::shared_ptr<const TextLayout> layout);
+
+  static void setMemoryBudget(size_t bytes);
+  static size_t getMemoryUsage();
+  static void clear();
+
+private:
+  struct Key {
+    TTF_Font *font;
+    std::string text;
+
+    bool operator==(const Key &other) const {
+      return font == other.font && text == other.text;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key &key) const {
+      return std::hash<std::string>()(key.text) ^
+             std::hash<TTF_Font *>()(key.font);
+    }
+  };
+
+  struct Entry {
+    Key key;
+    std::shared_ptr<const TextLayout> layout;
+    size_t bytes;
+  };
+
+  static size_t bytesFor(const Key &key, const TextLayout &layout);
+  static void evict();
+
+  inline static std::list<Entry> entries;
+  inline static std::unordered_map<Key, std::list<Entry>::iterator, KeyHash>
+      lookup;
+
+  inline static size_t budget = 32 << 20;
+  inline static size_t usage = 0;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#include "legacy.h"
+#include "map.h"
+#include <unordered_map>
+
+LegacyMap::~LegacyMap() {
+  // Parents and children point at each other, so break the cycles by hand.
+  for (const auto &node : this->nodes) {
+    node->parents.clear();
+    node->children.clear();
+  }
+}
+
+void LegacyMap::toMap(Map &map, TTF_Font *font) const {
+  std::unordered_map<const LegacyNode *, Node *> created;
+
+  auto convert = [&](const std::shared_ptr<LegacyNode> &legacy) -> Node * {
+    if (!legacy)
+      return nullptr;
+
+    Node *&node = created[legacy.get()];
+    if (!node) {
+      node = Node::create(legacy->x, legacy->y, font);
+      node->setTxtColor(legacy->textColor);
+      node->setBgColor(legacy->bgColor.r, legacy->bgColor.g,
+                       legacy->bgColor.b);
+      node->setCenteredText(legacy->centeredText);
+      node->restoreText(legacy->text, legacy->radius);
+    }
+    return node;
+  };
+
+  for (const auto &legacy : this->nodes)
+    convert(legacy);
+
+  for (const auto &legacy : this->parentNodes)
+    if (Node *node = convert(legacy))
+      node->setRoot(1);
+
+  for (const auto &legacy : this->nodes) {
+    Node *parent = convert(legacy);
+    if (!parent)
+      continue;
+
+    for (const auto &child : legacy->children)
+      if (Node *node = convert(child))
+        node->addParent(parent);
+  }
+
+  if (Node *current = convert(this->currentNode))
+    map.currentNode = current->getId();
+
+  map.dx = this->dx;
+  map.dy = this->dy;
+}
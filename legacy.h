@@ -0,0 +1,90 @@
+#ifndef LEGACY_H
+#define LEGACY_H
+
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/shared_ptr.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/access.hpp>
+#include <boost/serialization/nvp.hpp>
+
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+
+#include <SDL2/SDL_ttf.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Map;
+
+// Mirror of the original shared_ptr node graph, kept field for field so
+// boost archives written before nodes moved into Map's store still load.
+class LegacyNode {
+public:
+  std::vector<std::shared_ptr<LegacyNode>> parents;
+  std::vector<std::shared_ptr<LegacyNode>> children;
+
+  float x = 0;
+  float y = 0;
+
+  float radius = 0;
+
+  std::string text;
+
+  SDL_Color textColor = {0, 0, 0, 255};
+  SDL_Color bgColor = {37, 232, 250, 255};
+
+  bool centeredText = 1;
+
+private:
+  friend class boost::serialization::access;
+  template <class Archive>
+  void serialize(Archive &ar, const unsigned int version) {
+    ar &boost::serialization::make_nvp("x", x);
+    ar &boost::serialization::make_nvp("y", y);
+    ar &boost::serialization::make_nvp("radius", radius);
+    ar &boost::serialization::make_nvp("text", text);
+    ar &boost::serialization::make_nvp("textColor_r", textColor.r);
+    ar &boost::serialization::make_nvp("textColor_g", textColor.g);
+    ar &boost::serialization::make_nvp("textColor_b", textColor.b);
+    ar &boost::serialization::make_nvp("textColor_a", textColor.a);
+    ar &boost::serialization::make_nvp("bgColor_r", bgColor.r);
+    ar &boost::serialization::make_nvp("bgColor_g", bgColor.g);
+    ar &boost::serialization::make_nvp("bgColor_b", bgColor.b);
+    ar &boost::serialization::make_nvp("bgColor_a", bgColor.a);
+    ar &boost::serialization::make_nvp("centeredText", centeredText);
+    ar &boost::serialization::make_nvp("parents", parents);
+    ar &boost::serialization::make_nvp("children", children);
+  }
+};
+
+class LegacyMap {
+public:
+  LegacyMap() = default;
+  LegacyMap(const LegacyMap &) = delete;
+  LegacyMap &operator=(const LegacyMap &) = delete;
+  ~LegacyMap();
+
+  void toMap(Map &map, TTF_Font *font) const;
+
+  std::vector<std::shared_ptr<LegacyNode>> parentNodes;
+  std::vector<std::shared_ptr<LegacyNode>> nodes;
+
+  std::shared_ptr<LegacyNode> currentNode = nullptr;
+
+  float dx = 0;
+  float dy = 0;
+
+private:
+  friend class boost::serialization::access;
+  template <class Archive>
+  void serialize(Archive& ar, const unsigned int version) {
+    ar &boost::serialization::make_nvp("parentNodes", parentNodes);
+    ar &boost::serialization::make_nvp("nodes", nodes);
+    ar &boost::serialization::make_nvp("currentNode", currentNode);
+    ar &boost::serialization::make_nvp("dx", dx);
+    ar &boost::serialization::make_nvp("dy", dy);
+  }
+};
+
+#endif
@@ -1,7 +1,17 @@
+#include "forcelayout.h"
+#include "glyphatlas.h"
+#include "hierarchylayout.h"
+#include "history.h"
+#include "hud.h"
+#include "journal.h"
+#include "labelcache.h"
 #include "map.h"
+#include "mapexport.h"
+#include "mapsaver.h"
+#include "mindfile.h"
 #include "node.h"
+#include "profiler.h"
 #include <SDL2/SDL.h>
-#include <SDL2/SDL2_gfxPrimitives.h>
 #include <SDL2/SDL_hints.h>
 #include <SDL2/SDL_keyboard.h>
 #include <SDL2/SDL_keycode.h>
@@ -11,6 +21,9 @@
 #include <SDL2/SDL_ttf.h>
 #include <SDL2/SDL_video.h>
 
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
 #include <iostream>
 #include <random>
 
@@ -36,8 +49,21 @@ bool leftDown = false;
 bool typing = false;
 bool settingParent = false;
 bool typingFilename = false;
+bool typingSearch = false;
 
-SDL_Surface *filenameSurface;
+std::string searchQuery;
+std::vector<NodeId> searchResults;
+size_t searchPos = 0;
+
+Hud *hud;
+MapSaver *saver;
+Journal *journal;
+History *history;
+
+ForceLayout *layout;
+bool autoLayout = false;
+
+bool showProfile = false;
 
 bool ctrlDown = false;
 
@@ -54,6 +80,30 @@ SDL_Color clipboardColor = {};
 int zoomInt = 100;
 float zoom = 1;
 
+// Frames are only drawn when something changed. Anything that animates sets
+// `animating` to get paced frames every frameInterval milliseconds.
+bool animating = false;
+const Uint32 frameInterval = 16;
+// Longest simulated step auto-layout takes, so a stalled frame can't
+// overshoot.
+const float maxLayoutStep = 1 / 30.0f;
+const int idleTimeout = 250;
+
+// Memory caps for laid-out labels (CPU), glyph atlas pages (GPU) and the
+// undo/redo stacks.
+const size_t labelCacheBudget = 32 << 20;
+const size_t glyphAtlasBudget = 64 << 20;
+const size_t undoBudget = 1 << 20;
+
+const int fontSize = 18;
+
+// Jumping to a search match zooms in to at least this percentage.
+const int searchZoom = 50;
+
+// Frames captured by a trace, and how often the profiler panel refreshes.
+const int traceFrames = 300;
+const Uint32 profileRefresh = 250;
+
 void mouseDown(SDL_Event event) {
   if (event.button.button == 3) {
     mouseDownX = worldX;
@@ -62,7 +112,7 @@ void mouseDown(SDL_Event event) {
   }
 
   if (event.button.button == 1) {
-    if (Map::curMap->currentNode) {
+    if (Map::curMap->current()) {
       if (mouseY > 20 && mouseY < 275 && mouseX > width - 140) {
         onColorSlider = 1;
 
@@ -74,40 +124,34 @@ void mouseDown(SDL_Event event) {
   }
 
   if (event.button.button == 1) {
-    if (filenameSurface)
-      if (mouseX < filenameSurface->w && mouseY < filenameSurface->h) {
-        typingFilename = 1;
-        SDL_StartTextInput();
-        return;
-      }
+    SDL_Rect filenameRect = hud->getFilenameRect();
+    if (mouseX < filenameRect.w && mouseY < filenameRect.h) {
+      typingFilename = 1;
+      SDL_StartTextInput();
+      return;
+    }
 
     leftDown = 0;
-    for (const auto &node : Map::curMap->nodes) {
-      float dx = node->getX() - worldX;
-      float dy = node->getY() - worldY;
-      int d = static_cast<int>(std::sqrt(dx * dx + dy * dy));
-      if (d < node->getRadius()) {
-        if (settingParent) {
-          if (!Map::curMap->currentNode) {
-            settingParent = 0;
-            return;
-          }
-          Map::curMap->currentNode->toggleParent(node);
+    if (Node *node = Map::curMap->index.queryPoint(worldX, worldY)) {
+      if (settingParent) {
+        if (!Map::curMap->current()) {
           settingParent = 0;
-        } else {
-          Map::curMap->currentNode = node;
-          leftDown = 1;
-          mouseDownX = worldX;
-          mouseDownY = worldY;
-
-          nodeDownX = node->getX();
-          nodeDownY = node->getY();
+          return;
         }
-        break;
+        Map::curMap->current()->toggleParent(node);
+        settingParent = 0;
+      } else {
+        Map::curMap->currentNode = node->getId();
+        leftDown = 1;
+        mouseDownX = worldX;
+        mouseDownY = worldY;
+
+        nodeDownX = node->getX();
+        nodeDownY = node->getY();
       }
     }
     if (!leftDown) {
-      Map::curMap->currentNode = nullptr;
+      Map::curMap->currentNode = NodeId();
       typing = 0;
     }
   }
@@ -148,24 +192,100 @@ void mouseScroll(SDL_Event event) {
   dy -= prey - psty;
 }
 
+// Centres the view on node, zooming in far enough to read it.
+void focusNode(Node *node) {
+  if (zoomInt < searchZoom) {
+    zoomInt = searchZoom;
+    zoom = zoomInt / 100.0;
+  }
+  dx = width / (2 * zoom) - node->getX();
+  dy = height / (2 * zoom) - node->getY();
+}
+
+void showMatch() {
+  if (searchResults.empty())
+    return;
+
+  if (Node *node = Map::curMap->nodes.get(searchResults[searchPos])) {
+    Map::curMap->currentNode = node->getId();
+    focusNode(node);
+  }
+}
+
+void runSearch() {
+  std::vector<uint32_t> found;
+  Map::curMap->search.query(searchQuery, found);
+
+  searchResults.clear();
+  for (uint32_t index : found)
+    searchResults.push_back(Map::curMap->nodes.at(index)->getId());
+  Map::curMap->highlight(searchResults);
+
+  searchPos = 0;
+  showMatch();
+}
+
+void closeSearch() {
+  typingSearch = 0;
+  searchQuery.clear();
+  searchResults.clear();
+  Map::curMap->highlight({});
+  SDL_StopTextInput();
+}
+
+// Keys while the search box is open: Return steps through the matches,
+// Backspace edits the query and Escape closes it.
+void searchKey(SDL_Keycode key) {
+  if (key == SDLK_RETURN && !searchResults.empty()) {
+    searchPos = (searchPos + 1) % searchResults.size();
+    showMatch();
+  }
+
+  if (key == SDLK_BACKSPACE && !searchQuery.empty()) {
+    // Drop a whole UTF-8 sequence, not just its last byte.
+    size_t pos = searchQuery.size() - 1;
+    while (pos > 0 &&
+           (static_cast<unsigned char>(searchQuery[pos]) & 0xC0) == 0x80)
+      pos--;
+    searchQuery.erase(pos);
+    runSearch();
+  }
+
+  if (key == SDLK_ESCAPE)
+    closeSearch();
+}
+
 void keyDown(SDL_Event event) {
   SDL_Keycode key = event.key.keysym.sym;
   if (key == SDLK_LCTRL)
     ctrlDown = 1;
 
+  if (typingSearch) {
+    searchKey(key);
+    return;
+  }
+
+  if (key == SDLK_f && ctrlDown) {
+    typing = 0;
+    typingFilename = 0;
+    settingParent = 0;
+    typingSearch = 1;
+    SDL_StartTextInput();
+    return;
+  }
+
   if (key == SDLK_n && ctrlDown) {
-    std::shared_ptr<Node> node =
-        Node::create(1920 / 2 - dx, 1080 / 2 - dy, mainFont);
-    Map::curMap->parentNodes.push_back(node);
+    Node *node = Node::create(1920 / 2 - dx, 1080 / 2 - dy, mainFont);
+    node->setRoot(1);
   }
 
-  if (key == SDLK_BACKSPACE && ctrlDown && Map::curMap->currentNode) {
-    Map::curMap->currentNode->setText(renderer, "");
+  if (key == SDLK_BACKSPACE && ctrlDown && Map::curMap->current()) {
+    Map::curMap->current()->setText("");
     typing = 1;
     SDL_StartTextInput();
   }
 
-  if (key == SDLK_RETURN && Map::curMap->currentNode) {
+  if (key == SDLK_RETURN && Map::curMap->current()) {
     typing = !typing;
 
     if (typing)
@@ -183,53 +303,107 @@ void keyDown(SDL_Event event) {
     if (typingFilename)
       if (filename.length() > 0)
         filename.pop_back();
-    if (typing && Map::curMap->currentNode)
-      Map::curMap->currentNode->popChar(renderer);
+    if (typing && Map::curMap->current())
+      Map::curMap->current()->popChar();
   }
 
-  if (key == SDLK_DELETE && Map::curMap->currentNode) {
-    Map::curMap->currentNode->destruct();
-    Map::curMap->currentNode = nullptr;
+  if (key == SDLK_DELETE && Map::curMap->current()) {
+    Map::curMap->current()->destruct();
+    Map::curMap->currentNode = NodeId();
   }
 
-  if (key == SDLK_s && ctrlDown && Map::curMap->currentNode) {
+  if (key == SDLK_s && ctrlDown && Map::curMap->current()) {
     settingParent = 1;
   }
 
-  if (key == SDLK_c && ctrlDown && Map::curMap->currentNode) {
-    Map::curMap->currentNode->clear();
+  if (key == SDLK_c && ctrlDown && Map::curMap->current()) {
+    Map::curMap->current()->clear();
   }
 
   if (key == SDLK_o && ctrlDown) {
-    Map::curMap->loadMap(home + "/.mind/" + filename + ".mind", mainFont, &dx,
-                         &dy);
+    std::string path = home + "/.mind/" + filename + ".mind";
+    if (autoLayout)
+      layout->finish(*Map::curMap);
+    autoLayout = 0;
+    std::string previous = journal->getMapFile();
+    journal->detach();
+    Map::curMap->history = nullptr;
+    if (Map::curMap->loadMap(path, mainFont, &dx, &dy)) {
+      // Pick up edits made after the file was last checkpointed.
+      Journal::replay(path, mainFont);
+      journal->attach(path, false);
+      history->clear();
+    } else if (!previous.empty()) {
+      // The old map is still open, so keep logging its edits.
+      journal->attach(previous, false);
+    }
+    Map::curMap->history = history;
     zoomInt = 100;
     zoom = 1;
   }
 
   if (key == SDLK_w && ctrlDown) {
-    Map::curMap->saveMap(home + "/.mind/" + filename + ".mind");
+    std::string path = home + "/.mind/" + filename + ".mind";
+    if (journal->getMapFile() != path)
+      journal->attach(path, true);
+    journal->checkpoint(*saver);
+  }
+
+  if (key == SDLK_l && ctrlDown) {
+    autoLayout = !autoLayout;
+    if (!autoLayout)
+      layout->finish(*Map::curMap);
+  }
+
+  if (key == SDLK_h && ctrlDown) {
+    if (autoLayout)
+      layout->finish(*Map::curMap);
+    autoLayout = 0;
+    HierarchyLayout::apply(*Map::curMap, Map::curMap->current());
+  }
+
+  if (key == SDLK_p && ctrlDown && Map::curMap->current()) {
+    Map::curMap->current()->setPinned(!Map::curMap->current()->isPinned());
+  }
+
+  if (key == SDLK_u && ctrlDown) {
+    history->undo(mainFont);
+  }
+
+  if (key == SDLK_y && ctrlDown) {
+    history->redo(mainFont);
   }
 
   if (key == SDLK_a && ctrlDown) {
-    if (Map::curMap->currentNode) {
-      clipboardColor = Map::curMap->currentNode->getBgColor();
+    if (Map::curMap->current()) {
+      clipboardColor = Map::curMap->current()->getBgColor();
     }
   }
 
   if (key == SDLK_r && ctrlDown) {
-    if (Map::curMap->currentNode) {
-      Map::curMap->currentNode->setBgColor(dis(gen), dis(gen), dis(gen));
+    if (Map::curMap->current()) {
+      Map::curMap->current()->setBgColor(dis(gen), dis(gen), dis(gen));
     }
   }
 
   if (key == SDLK_z && ctrlDown) {
-    if (Map::curMap->currentNode) {
-      Map::curMap->currentNode->setBgColor(clipboardColor.r, clipboardColor.g,
+    if (Map::curMap->current()) {
+      Map::curMap->current()->setBgColor(clipboardColor.r, clipboardColor.g,
                                            clipboardColor.b);
     }
   }
 
+  if (key == SDLK_F3) {
+    showProfile = !showProfile;
+    Profiler::setEnabled(showProfile);
+    if (!showProfile)
+      hud->setProfile({});
+  }
+
+  if (key == SDLK_F4 && !Profiler::isTracing()) {
+    Profiler::startTrace(home + "/.mind/trace.json", traceFrames);
+  }
+
   if (key == SDLK_ESCAPE) {
     settingParent = 0;
     typing = 0;
@@ -245,14 +419,115 @@ void keyUp(SDL_Event event) {
 }
 
 void typed(char text[32]) {
-  if (typingFilename) {
+  if (typingSearch) {
+    searchQuery += text;
+    runSearch();
+  } else if (typingFilename) {
     filename += text;
   } else if (typing)
-    if (Map::curMap->currentNode)
-      Map::curMap->currentNode->appendText(renderer, text);
+    if (Map::curMap->current())
+      Map::curMap->current()->appendText(text);
+}
+
+void updateMouse() {
+  SDL_GetMouseState(&mouseX, &mouseY);
+  worldX = static_cast<int>(mouseX / zoom - dx);
+  worldY = static_cast<int>(mouseY / zoom - dy);
+}
+
+// Dispatches one event and reports whether the scene needs a new frame.
+bool handleEvent(SDL_Event event) {
+  updateMouse();
+
+  switch (event.type) {
+  case SDL_QUIT:
+    running = false;
+    return 0;
+  case SDL_MOUSEBUTTONDOWN:
+    mouseDown(event);
+    return 1;
+  case SDL_MOUSEBUTTONUP:
+    mouseUp(event);
+    return 1;
+  case SDL_MOUSEMOTION:
+    return leftDown || rightDown || onColorSlider;
+  case SDL_MOUSEWHEEL:
+    mouseScroll(event);
+    return 1;
+  case SDL_KEYDOWN:
+    keyDown(event);
+    return 1;
+  case SDL_KEYUP:
+    keyUp(event);
+    return 1;
+  case SDL_TEXTINPUT:
+    typed(event.text.text);
+    return 1;
+  case SDL_WINDOWEVENT:
+    return 1;
+  }
+
+  return 0;
 }
 
-int main() {
+// Loads mapFile with the UI font and hands it to run, for the command line
+// modes that work without a window.
+bool runHeadless(
+    const std::string &mapFile,
+    const std::function<bool(Map &, TTF_Font *, const std::string &)> &run) {
+  TTF_Init();
+  std::string fontFile = home + "/.mind/res/mainFont.ttf";
+  TTF_Font *font = TTF_OpenFont(fontFile.c_str(), fontSize);
+
+  if (!font) {
+    std::cout << "TTF_OpenFont failed: " << TTF_GetError() << '\n';
+    return false;
+  }
+
+  Map map;
+  Map::curMap = &map;
+  float mapDx = 0, mapDy = 0;
+  bool ok = map.loadMap(mapFile, font, &mapDx, &mapDy) &&
+            run(map, font, fontFile);
+  Map::curMap = nullptr;
+
+  LabelCache::clear();
+  TTF_CloseFont(font);
+  TTF_Quit();
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  // main.exe --convert old.mind new.mind rewrites a legacy boost archive in
+  // the native format without opening a window.
+  if (argc == 4 && std::string(argv[1]) == "--convert")
+    return MindFile::convertLegacy(argv[2], argv[3]) ? 0 : 1;
+
+  // main.exe --export map.mind poster.png [scale] renders the whole map to
+  // an image, also without a window.
+  if ((argc == 4 || argc == 5) && std::string(argv[1]) == "--export")
+    return runHeadless(argv[2],
+                       [&](Map &map, TTF_Font *font,
+                           const std::string &fontFile) {
+                         Journal::replay(argv[2], font);
+                         return MapExport::writePng(
+                             map, font, fontFile, fontSize, argv[3],
+                             argc == 5 ? std::atof(argv[4]) : 1);
+                       })
+               ? 0
+               : 1;
+
+  // main.exe --import outline.opml notes.mind reads an OPML outline, a
+  // Graphviz graph or a JSON node list into a new map.
+  if (argc == 4 && std::string(argv[1]) == "--import")
+    return runHeadless(argv[2],
+                       [&](Map &map, TTF_Font *, const std::string &) {
+                         return MindFile::write(argv[3],
+                                                MindFile::snapshot(map));
+                       })
+               ? 0
+               : 1;
+
   std::cout << home << '\n';
   SDL_Init(SDL_INIT_EVERYTHING);
   TTF_Init();
@@ -274,7 +549,8 @@ int main() {
     return 0;
   }
 
-  mainFont = TTF_OpenFont((home + "/.mind/res/mainFont.ttf").c_str(), 18);
+  std::string fontFile = home + "/.mind/res/mainFont.ttf";
+  mainFont = TTF_OpenFont(fontFile.c_str(), fontSize);
 
   if (!mainFont) {
     std::cout << "TTF_OpenFont failed: " << TTF_GetError() << '\n';
@@ -285,58 +561,98 @@ int main() {
   SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "2");
 
   Map::curMap = new Map();
+  hud = new Hud(renderer, mainFont);
+  saver = new MapSaver();
+  journal = new Journal();
+  history = new History();
+  history->setMemoryBudget(undoBudget);
+  layout = new ForceLayout();
+  Map::curMap->history = history;
+
+  LabelCache::setMemoryBudget(labelCacheBudget);
+  GlyphAtlas::setMemoryBudget(glyphAtlasBudget);
+  GlyphAtlas::setFontFile(mainFont, fontFile, fontSize);
+
+  bool dirty = 1;
+  Uint32 lastFrame = 0;
+  Uint32 lastProfile = 0;
+  MapSaver::State saveState = MapSaver::State::Idle;
 
   while (running) {
+    // Sleep until input arrives unless a frame is already owed; while
+    // animating, wake up in time for the next paced frame instead.
+    int timeout = idleTimeout;
+    if (dirty) {
+      timeout = 0;
+    } else if (animating) {
+      Uint32 elapsed = SDL_GetTicks() - lastFrame;
+      timeout = elapsed < frameInterval ? frameInterval - elapsed : 0;
+    }
+
     SDL_Event event;
-    while (SDL_PollEvent(&event)) {
-      switch (event.type) {
-      case SDL_QUIT:
-        running = false;
-        break;
-      case SDL_MOUSEBUTTONDOWN:
-        mouseDown(event);
-        break;
-      case SDL_MOUSEBUTTONUP:
-        mouseUp(event);
-        break;
-      case SDL_MOUSEWHEEL:
-        mouseScroll(event);
-        break;
-      case SDL_KEYDOWN:
-        keyDown(event);
-        break;
-      case SDL_KEYUP:
-        keyUp(event);
-        break;
-      case SDL_TEXTINPUT:
-        typed(event.text.text);
-        break;
-      }
+    if (SDL_WaitEventTimeout(&event, timeout)) {
+      Profiler::Scope scope(Profiler::Phase::Events);
+      dirty |= handleEvent(event);
+      while (SDL_PollEvent(&event))
+        dirty |= handleEvent(event);
     }
 
+    // Redraw for save progress while a save runs, and once more when it
+    // finishes.
+    MapSaver::State state = saver->getState();
+    if (state != saveState)
+      dirty = 1;
+    saveState = state;
+    // A trace keeps frames coming so it covers the frames it asked for, and
+    // labels fill in as their glyphs come back from the workers.
+    animating = state == MapSaver::State::Saving || autoLayout ||
+                Profiler::isTracing() || GlyphAtlas::isLoading();
+
+    if (animating && SDL_GetTicks() - lastFrame >= frameInterval)
+      dirty = 1;
+
+    // Drags stay open until the button comes up so they undo as one step.
+    if (!leftDown && !onColorSlider)
+      history->commit();
+
+    if (journal->needsCompaction())
+      journal->checkpoint(*saver);
+
+    if (!dirty)
+      continue;
+
+    dirty = 0;
+    Profiler::beginFrame();
+    float dt = std::min((SDL_GetTicks() - lastFrame) / 1000.0f, maxLayoutStep);
+    lastFrame = SDL_GetTicks();
+
+    updateMouse();
+
     if (onColorSlider && mouseY >= 20 && mouseY <= 275) {
       if (mouseX > width - 120 && mouseX < width - 100)
-        Map::curMap->currentNode->setBgColor(275 - mouseY, -1, -1);
+        Map::curMap->current()->setBgColor(275 - mouseY, -1, -1);
       if (mouseX > width - 80 && mouseX < width - 60)
-        Map::curMap->currentNode->setBgColor(-1, 275 - mouseY, -1);
+        Map::curMap->current()->setBgColor(-1, 275 - mouseY, -1);
       if (mouseX > width - 40 && mouseX < width - 20)
-        Map::curMap->currentNode->setBgColor(-1, -1, 275 - mouseY);
+        Map::curMap->current()->setBgColor(-1, -1, 275 - mouseY);
     }
 
-    SDL_GetMouseState(&mouseX, &mouseY);
-    worldX = static_cast<int>(mouseX / zoom - dx);
-    worldY = static_cast<int>(mouseY / zoom - dy);
-
-    if (leftDown && Map::curMap->currentNode) {
+    if (leftDown && Map::curMap->current()) {
       if (ctrlDown) {
-        Map::curMap->currentNode->setXRec(nodeDownX + worldX - mouseDownX);
-        Map::curMap->currentNode->setYRec(nodeDownY + worldY - mouseDownY);
+        Map::curMap->current()->setPosRec(nodeDownX + worldX - mouseDownX,
+                                          nodeDownY + worldY - mouseDownY);
       } else {
-        Map::curMap->currentNode->setX(nodeDownX + worldX - mouseDownX);
-        Map::curMap->currentNode->setY(nodeDownY + worldY - mouseDownY);
+        Map::curMap->current()->setX(nodeDownX + worldX - mouseDownX);
+        Map::curMap->current()->setY(nodeDownY + worldY - mouseDownY);
       }
     }
 
+    if (autoLayout) {
+      Profiler::Scope scope(Profiler::Phase::Layout);
+      layout->step(*Map::curMap, dt,
+                   leftDown ? Map::curMap->currentNode : NodeId());
+    }
+
     SDL_GetWindowSize(window, &width, &height);
 
     SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
@@ -345,89 +661,69 @@ int main() {
     Map::curMap->dx = dx + (rightDown ? worldX - mouseDownX : 0);
     Map::curMap->dy = dy + (rightDown ? worldY - mouseDownY : 0);
 
-    SDL_RenderSetScale(renderer, 1, 1);
-
-    for (const auto &node : Map::curMap->nodes)
-      if (node)
-        node->renderLines(renderer, zoom);
-
-    SDL_RenderSetScale(renderer, zoom, zoom);
-
-    for (const auto &node : Map::curMap->nodes)
-      if (node)
-        node->render(renderer);
+    Map::curMap->render(renderer, zoom, width, height);
 
     SDL_RenderSetScale(renderer, 1, 1);
 
-    if (filenameSurface)
-      SDL_FreeSurface(filenameSurface);
-    filenameSurface = TTF_RenderText_Blended(
-        mainFont, (" File: " + filename + ".mind").c_str(),
-        SDL_Color{0, 0, 0, 255});
-    SDL_Texture *filenameTexture =
-        SDL_CreateTextureFromSurface(renderer, filenameSurface);
-    SDL_Rect rect = {0, 0, filenameSurface->w + 10, filenameSurface->h};
-    SDL_SetRenderDrawColor(renderer, 150, 200, 255, 255);
-    SDL_RenderFillRect(renderer, &rect);
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    SDL_RenderDrawRect(renderer, &rect);
-    rect = {0, 0, filenameSurface->w, filenameSurface->h};
-    SDL_RenderCopy(renderer, filenameTexture, nullptr, &rect);
-    SDL_DestroyTexture(filenameTexture);
-
-    if (Map::curMap->currentNode) {
-      SDL_Rect rect = {width - 140, 0, 140, 335};
-      SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-      SDL_RenderFillRect(renderer, &rect);
-      SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-      SDL_RenderDrawRect(renderer, &rect);
-
-      for (int i = 0; i < 255; i++) {
-        SDL_Rect rect = {width - 120, 275 - i, 20, 1};
-
-        int r = Map::curMap->currentNode->getBgColor().r;
-        int g = Map::curMap->currentNode->getBgColor().g;
-        int b = Map::curMap->currentNode->getBgColor().b;
-        
-        SDL_SetRenderDrawColor(renderer, i, g, b, 255);
-        SDL_RenderFillRect(renderer, &rect);
-
-        rect.x = width - 80;
-        SDL_SetRenderDrawColor(renderer, r, i, b, 255);
-        SDL_RenderFillRect(renderer, &rect);
-
-        rect.x = width - 40;
-        SDL_SetRenderDrawColor(renderer, r, g, i, 255);
-        SDL_RenderFillRect(renderer, &rect);
-      }
-
-      SDL_Color col = Map::curMap->currentNode->getBgColor();
-
-      SDL_SetRenderDrawColor(renderer, 127, 127, 127, 255);
-
-      rect = {width - 120, 275 - col.r - 2, 20, 5};
-      SDL_RenderDrawRect(renderer, &rect);
-      rect = {width - 80, 275 - col.g - 2, 20, 5};
-      SDL_RenderDrawRect(renderer, &rect);
-      rect = {width - 40, 275 - col.b - 2, 20, 5};
-      SDL_RenderDrawRect(renderer, &rect);
-
-      rect = {width - 120, 295, 100, 20};
-      SDL_SetRenderDrawColor(renderer, col.r, col.g, col.b, col.a);
-      SDL_RenderFillRect(renderer, &rect);
+    hud->setFilename(filename);
+    switch (saveState) {
+    case MapSaver::State::Idle:
+      hud->setSaveStatus("");
+      break;
+    case MapSaver::State::Saving:
+      hud->setSaveStatus(
+          " Saving " +
+          std::to_string(static_cast<int>(saver->getProgress() * 100)) + "%");
+      break;
+    case MapSaver::State::Saved:
+      hud->setSaveStatus(" Saved");
+      break;
+    case MapSaver::State::Failed:
+      hud->setSaveStatus(" Save failed");
+      break;
+    }
+    hud->setZoom(static_cast<int>(zoom * 100));
+    if (typingSearch) {
+      std::string matches;
+      if (!searchResults.empty())
+        matches = std::to_string(searchPos + 1) + "/" +
+                  std::to_string(searchResults.size());
+      else if (!searchQuery.empty())
+        matches = "no matches";
+      hud->setSearch(" Find: " + searchQuery + "  " + matches + " ");
+    } else {
+      hud->setSearch("");
+    }
+    if (Map::curMap->current()) {
+      SDL_Color color = Map::curMap->current()->getBgColor();
+      hud->setColor(&color);
+    } else {
+      hud->setColor(nullptr);
+    }
+    if (showProfile && SDL_GetTicks() - lastProfile >= profileRefresh) {
+      hud->setProfile(Profiler::summary());
+      lastProfile = SDL_GetTicks();
+    }
+    {
+      Profiler::Scope scope(Profiler::Phase::Hud);
+      hud->render(width, height);
     }
 
-    SDL_Surface* zoomSurf = TTF_RenderText_Blended(mainFont, (std::to_string(static_cast<int>(zoom * 100)) + std::string("%")).c_str(), SDL_Color{0, 0, 0, 255});
-    SDL_Texture* zoomText = SDL_CreateTextureFromSurface(renderer, zoomSurf);
-    rect = {0, height - zoomSurf->h, zoomSurf->w, zoomSurf->h};
-    SDL_RenderCopy(renderer, zoomText, nullptr, &rect);
-
-    SDL_FreeSurface(zoomSurf);
-    SDL_DestroyTexture(zoomText);
-
-    SDL_RenderPresent(renderer);
+    {
+      Profiler::Scope scope(Profiler::Phase::Present);
+      SDL_RenderPresent(renderer);
+    }
+    Profiler::endFrame();
   }
 
+  // The saver reports finished checkpoints to the journal, so it goes first.
+  delete saver;
+  delete journal;
+  delete history;
+  delete layout;
+  delete hud;
+  GlyphAtlas::destroyAll();
+  LabelCache::clear();
   SDL_DestroyRenderer(renderer);
   SDL_DestroyWindow(window);
 
@@ -1,32 +1,302 @@
 #include "map.h"
+#include "history.h"
+#include "importer.h"
+#include "journal.h"
+#include "legacy.h"
+#include "mindfile.h"
+#include "profiler.h"
+#include <algorithm>
 #include <exception>
 #include <fstream>
+#include <iostream>
 
-void Map::saveMap(const std::string &filename) {
-  std::ofstream ofs(filename, std::ios::binary);
-  boost::archive::binary_oarchive oa(ofs);
-  oa << *this;
-  ofs.close();
+// World-space slack around the viewport so selection halos and arrowheads
+// that poke in from just off screen still get drawn.
+static constexpr float cullMargin = 20;
+
+// Levels of detail. Nodes smaller than blobRadius on screen are drawn as
+// blobs binned into blobCell-pixel cells; labels are dropped once text would
+// be under minTextZoom of its real size.
+static constexpr float blobRadius = 4;
+static constexpr float blobCell = 6;
+static constexpr float minTextZoom = 0.3f;
+
+Node *Map::current() const { return this->nodes.get(this->currentNode); }
+
+void Map::record(const MapOp &op) {
+  this->journalSequence++;
+  if (this->journal)
+    this->journal->append(op, this->journalSequence);
+  if (this->history)
+    this->history->record(op);
+}
+
+bool Map::apply(const MapOp &op, TTF_Font *font) {
+  if (op.type == MapOp::Create) {
+    Node *node = this->nodes.createAt(op.node, op.x, op.y, font);
+    if (!node)
+      return false;
+    this->order.insert(node->id.index);
+    this->index.insert(node, op.x, op.y, node->radius);
+    this->search.set(node->id.index, node->text);
+    this->record(op);
+    return true;
+  }
+
+  Node *node = this->nodes.get(op.node);
+  if (!node)
+    return false;
+
+  switch (op.type) {
+  case MapOp::Create:
+    break;
+  case MapOp::Destroy:
+    node->destruct();
+    break;
+  case MapOp::SetText:
+    node->setText(op.text);
+    break;
+  case MapOp::SetBgColor:
+    node->setBgColor(op.color.r, op.color.g, op.color.b);
+    break;
+  case MapOp::SetRoot:
+    node->setRoot(op.flag);
+    break;
+  case MapOp::SetPinned:
+    node->setPinned(op.flag);
+    break;
+  case MapOp::SetTxtColor:
+    node->setTxtColor(op.color);
+    break;
+  case MapOp::SetCenteredText:
+    node->setCenteredText(op.flag);
+    break;
+  case MapOp::AddEdge:
+  case MapOp::RemoveEdge: {
+    Node *child = this->nodes.get(op.other);
+    if (!child)
+      return false;
+    if (op.type == MapOp::AddEdge)
+      child->addParent(node);
+    else
+      child->removeParent(node);
+    break;
+  }
+  case MapOp::Move:
+    node->x = op.x;
+    node->y = op.y;
+    node->reindex();
+    node->recordMove(op.oldX, op.oldY);
+    break;
+  case MapOp::Translate:
+    node->translateRec(op.x, op.y);
+    break;
+  case MapOp::Clear:
+    node->clear();
+    break;
+  }
+  return true;
 }
 
-void Map::loadMap(const std::string &filename, TTF_Font *font, float *dx,
+bool Map::revert(const MapOp &op, TTF_Font *font) {
+  if (op.type == MapOp::Destroy) {
+    MapOp create{MapOp::Create, op.node};
+    create.x = op.x;
+    create.y = op.y;
+    if (!this->apply(create, font))
+      return false;
+
+    Node *node = this->nodes.get(op.node);
+    node->setTxtColor(op.textColor);
+    node->setCenteredText(op.centeredText);
+    node->setBgColor(op.color.r, op.color.g, op.color.b);
+    node->setRoot(op.flag);
+    node->setPinned(op.oldFlag);
+    node->setText(op.text);
+
+    for (NodeId id : op.parents)
+      if (Node *parent = this->nodes.get(id))
+        node->addParent(parent);
+    for (NodeId id : op.children)
+      if (Node *child = this->nodes.get(id))
+        child->addParent(node);
+    return true;
+  }
+
+  Node *node = this->nodes.get(op.node);
+  if (!node)
+    return false;
+
+  switch (op.type) {
+  case MapOp::Create:
+    node->destruct();
+    break;
+  case MapOp::Destroy:
+    break;
+  case MapOp::SetText:
+    node->setText(op.oldText);
+    break;
+  case MapOp::SetBgColor:
+    node->setBgColor(op.oldColor.r, op.oldColor.g, op.oldColor.b);
+    break;
+  case MapOp::SetRoot:
+    node->setRoot(op.oldFlag);
+    break;
+  case MapOp::SetPinned:
+    node->setPinned(op.oldFlag);
+    break;
+  case MapOp::SetTxtColor:
+    node->setTxtColor(op.oldColor);
+    break;
+  case MapOp::SetCenteredText:
+    node->setCenteredText(op.oldFlag);
+    break;
+  case MapOp::AddEdge:
+  case MapOp::RemoveEdge: {
+    Node *child = this->nodes.get(op.other);
+    if (!child)
+      return false;
+    if (op.type == MapOp::AddEdge)
+      child->removeParent(node);
+    else
+      child->addParent(node);
+    break;
+  }
+  case MapOp::Move:
+    node->x = op.oldX;
+    node->y = op.oldY;
+    node->reindex();
+    node->recordMove(op.x, op.y);
+    break;
+  case MapOp::Translate:
+    node->translateRec(-op.x, -op.y);
+    break;
+  case MapOp::Clear:
+    for (NodeId id : op.parents)
+      if (Node *parent = this->nodes.get(id))
+        node->addParent(parent);
+    for (NodeId id : op.children)
+      if (Node *child = this->nodes.get(id))
+        child->addParent(node);
+    break;
+  }
+  return true;
+}
+
+bool Map::saveMap(const std::string &filename) {
+  return MindFile::write(filename, MindFile::snapshot(*this));
+}
+
+bool Map::loadMap(const std::string &filename, TTF_Font *font, float *dx,
                   float *dy) {
-  try {
+  if (Importer::canImport(filename)) {
+    if (!Importer::load(*this, filename, font))
+      return false;
+  } else if (MindFile::isMindFile(filename)) {
+    if (!MindFile::load(*this, filename, font))
+      return false;
+  } else {
+    // Maps saved before the native format are boost archives.
+    LegacyMap legacy;
+    try {
+      std::ifstream ifs(filename, std::ios::binary);
+      boost::archive::binary_iarchive ia(ifs);
+      ia >> legacy;
+    } catch (const std::exception &e) {
+      std::cout << "Failed to load " << filename << ": " << e.what() << '\n';
+      return false;
+    }
 
+    this->currentNode = NodeId();
+    this->journalSequence = 0;
     this->nodes.clear();
-    this->parentNodes.clear();
+    this->order.clear();
+    this->index.clear();
+
+    legacy.toMap(*this, font);
+  }
+
+  // Loaders restore labels without going through setText; index them all
+  // in one pass instead.
+  this->search.build(this->nodes);
+  this->highlighted.clear();
 
-    std::ifstream ifs(filename, std::ios::binary);
-    boost::archive::binary_iarchive ia(ifs);
-    ia >> *this;
-    ifs.close();
+  (*dx) = this->dx;
+  (*dy) = this->dy;
+  return true;
+}
+
+void Map::highlight(std::vector<NodeId> ids) {
+  std::sort(ids.begin(), ids.end(), [](NodeId a, NodeId b) {
+    return a.index < b.index;
+  });
+  this->highlighted = std::move(ids);
+}
+
+bool Map::isHighlighted(NodeId id) const {
+  auto it = std::lower_bound(
+      this->highlighted.begin(), this->highlighted.end(), id,
+      [](NodeId a, NodeId b) { return a.index < b.index; });
+  return it != this->highlighted.end() && *it == id;
+}
 
-    for (const auto &node : this->nodes) {
-      node->setFont(font);
+void Map::render(SDL_Renderer *renderer, float zoom, int width, int height) {
+  float x1 = -this->dx - cullMargin;
+  float y1 = -this->dy - cullMargin;
+  float x2 = width / zoom - this->dx + cullMargin;
+  float y2 = height / zoom - this->dy + cullMargin;
+
+  {
+    Profiler::Scope scope(Profiler::Phase::Edges);
+    this->visibleEdges.clear();
+    this->index.queryEdges(x1, y1, x2, y2, this->visibleEdges);
+
+    this->edgeBatch.begin(this->dx, this->dy, zoom);
+    for (const auto &[from, to] : this->visibleEdges)
+      this->edgeBatch.addEdge(from, to);
+
+    SDL_RenderSetScale(renderer, 1, 1);
+    this->edgeBatch.flush(renderer);
+  }
+
+  {
+    Profiler::Scope scope(Profiler::Phase::Nodes);
+    this->visibleNodes.clear();
+    this->index.queryRect(x1, y1, x2, y2, this->visibleNodes);
+
+    // Specks go to the blob batch and need no ordering; only nodes drawn in
+    // full are stacked. The selection always gets full detail.
+    this->blobBatch.begin(blobCell);
+    size_t detailed = 0;
+    for (Node *node : this->visibleNodes) {
+      if (node->getRadius() * zoom < blobRadius &&
+          node->getId() != this->currentNode) {
+        this->blobBatch.add((node->getX() + this->dx) * zoom,
+                            (node->getY() + this->dy) * zoom,
+                            node->getRadius() * zoom, node->getBgColor());
+      } else {
+        this->visibleNodes[detailed++] = node;
+      }
     }
+    this->visibleNodes.resize(detailed);
+    this->blobBatch.flush(renderer);
+
+    // Keep overlapping nodes stacked in creation order as they move between
+    // grid cells.
+    std::sort(this->visibleNodes.begin(), this->visibleNodes.end(),
+              [](const Node *a, const Node *b) {
+                return a->getDrawOrder() < b->getDrawOrder();
+              });
 
-    (*dx) = this->dx;
-    (*dy) = this->dy;
-  } catch (std::exception e) {
+    SDL_RenderSetScale(renderer, zoom, zoom);
+
+    bool withText = zoom >= minTextZoom;
+    this->circleBatch.begin(zoom);
+    for (Node *node : this->visibleNodes)
+      node->render(renderer, this->circleBatch, withText);
+    this->circleBatch.flush(renderer);
   }
+
+  Profiler::Scope glyphs(Profiler::Phase::Glyphs);
+  GlyphAtlas::flushAll(renderer, zoom);
 }
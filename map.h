@@ -1,50 +1,75 @@
 #ifndef MAP_H
 #define MAP_H
 
-#include <boost/serialization/vector.hpp>
-#include <boost/serialization/shared_ptr.hpp>
-#include <boost/serialization/weak_ptr.hpp>
-#include <boost/serialization/string.hpp>
-#include <boost/serialization/export.hpp>
-#include <boost/serialization/assume_abstract.hpp>
-#include <boost/serialization/access.hpp>
-#include <boost/serialization/nvp.hpp>
-
-#include <boost/archive/binary_oarchive.hpp>
-#include <boost/archive/binary_iarchive.hpp>
-
 #include <memory>
 
+#include "blobbatch.h"
+#include "circlebatch.h"
+#include "edgebatch.h"
+#include "glyphatlas.h"
+#include "mapop.h"
 #include "node.h"
+#include "nodestore.h"
+#include "searchindex.h"
+#include "spatialindex.h"
+#include "topoorder.h"
+#include <cstdint>
 #include <vector>
 
+class History;
+class Journal;
+
 class Map {
 public:
 
-  std::vector<std::shared_ptr<Node>> parentNodes;
-  std::vector<std::shared_ptr<Node>> nodes;
+  NodeStore nodes;
+  TopoOrder order{nodes};
+
+  NodeId currentNode;
+  Node *current() const;
 
-  std::shared_ptr<Node> currentNode = nullptr;
+  SpatialIndex index;
+  SearchIndex search;
 
   float dx;
   float dy;
-  
+
+  // Sequence number of the last operation applied to this map. Snapshots
+  // carry it so journal replay knows where to pick up.
+  uint64_t journalSequence = 0;
+  // Set while the map is backed by a file; receives every recorded op.
+  Journal *journal = nullptr;
+  // Receives every recorded op for undo, unless it is replaying one itself.
+  History *history = nullptr;
+
+  void record(const MapOp &op);
+
+  // Redoes or undoes a recorded op through Node, so the change is recorded
+  // again like any other edit. Both return false if the nodes it names are
+  // gone.
+  bool apply(const MapOp &op, TTF_Font *font);
+  bool revert(const MapOp &op, TTF_Font *font);
+
   inline static Map* curMap = nullptr;
 
-  void saveMap(const std::string &filename);
-  void loadMap(const std::string &filename, TTF_Font* font, float *dx, float *dy);
+  bool saveMap(const std::string &filename);
+  bool loadMap(const std::string &filename, TTF_Font* font, float *dx, float *dy);
+
+  void render(SDL_Renderer *renderer, float zoom, int width, int height);
+
+  // Nodes drawn with a search halo until the next call.
+  void highlight(std::vector<NodeId> ids);
+  bool isHighlighted(NodeId id) const;
 
 private:
-  friend class boost::serialization::access;
-  template <class Archive>
-  void serialize(Archive& ar, const unsigned int version) {
-    ar &boost::serialization::make_nvp("parentNodes", parentNodes);
-    ar &boost::serialization::make_nvp("nodes", nodes);
-    ar &boost::serialization::make_nvp("currentNode", currentNode);
-    ar &boost::serialization::make_nvp("dx", dx);
-    ar &boost::serialization::make_nvp("dy", dy);
-  }
-  
+  // Sorted by slot index.
+  std::vector<NodeId> highlighted;
+  std::vector<Node *> visibleNodes;
+  std::vector<std::pair<Node *, Node *>> visibleEdges;
+  EdgeBatch edgeBatch;
+  BlobBatch blobBatch;
+  CircleBatch circleBatch;
+
 };
 
 #endif
@@ -0,0 +1,585 @@
+#include "mapexport.h"
+#include "glyphrasterizer.h"
+#include "labelcache.h"
+#include "map.h"
+#include "textlayout.h"
+#include <zlib.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+// Tiles are tileSize pixels square; a band is one row of them.
+static constexpr int tileSize = 256;
+// Longest image side, in pixels.
+static constexpr double maxSide = 1 << 16;
+// World-space margin around the map, and the slack each tile is drawn with
+// so halos and arrowheads from just outside still reach into it.
+static constexpr float margin = 20;
+static constexpr float cullMargin = 20;
+// Labels are left out below the scale they're dropped at on screen.
+static constexpr float minTextScale = 0.3f;
+// Finished bands each worker may leave queued for the writer.
+static constexpr size_t bandsPerWorker = 2;
+static constexpr int sheetWidth = 2048;
+static constexpr int glyphPadding = 1;
+
+static void put32(unsigned char *out, uint32_t value) {
+  out[0] = static_cast<unsigned char>(value >> 24);
+  out[1] = static_cast<unsigned char>(value >> 16);
+  out[2] = static_cast<unsigned char>(value >> 8);
+  out[3] = static_cast<unsigned char>(value);
+}
+
+static void writeChunk(std::ofstream &out, const char *type,
+                       const unsigned char *data, size_t size) {
+  unsigned char header[8];
+  put32(header, static_cast<uint32_t>(size));
+  std::copy(type, type + 4, header + 4);
+
+  uLong crc = crc32(0, header + 4, 4);
+  // crc32 treats a null buffer as a request for the initial value.
+  if (size)
+    crc = crc32(crc, data, static_cast<uInt>(size));
+  unsigned char trailer[4];
+  put32(trailer, static_cast<uint32_t>(crc));
+
+  out.write(reinterpret_cast<const char *>(header), 8);
+  if (size)
+    out.write(reinterpret_cast<const char *>(data), size);
+  out.write(reinterpret_cast<const char *>(trailer), 4);
+}
+
+bool MapExport::writePng(const Map &map, TTF_Font *font,
+                         const std::string &fontFile, int pointSize,
+                         const std::string &path, float scale) {
+  if (!(scale > 0)) {
+    std::cout << "Export scale must be positive\n";
+    return false;
+  }
+
+  MapExport job(map, scale);
+  if (!job.measure())
+    return false;
+  if (scale >= minTextScale && font)
+    job.layOut(font, fontFile, pointSize);
+  return job.write(path);
+}
+
+MapExport::MapExport(const Map &map, float scale) : map(map), scale(scale) {}
+
+bool MapExport::measure() {
+  bool any = false;
+  float maxX = 0;
+  float maxY = 0;
+  this->map.nodes.forEach([&](Node *node) {
+    float r = node->getRadius();
+    if (!any) {
+      this->minX = node->getX() - r;
+      this->minY = node->getY() - r;
+      maxX = node->getX() + r;
+      maxY = node->getY() + r;
+      any = true;
+    }
+    this->minX = std::min(this->minX, node->getX() - r);
+    this->minY = std::min(this->minY, node->getY() - r);
+    maxX = std::max(maxX, node->getX() + r);
+    maxY = std::max(maxY, node->getY() + r);
+  });
+
+  if (!any) {
+    std::cout << "Nothing to export: the map is empty\n";
+    return false;
+  }
+
+  this->minX -= margin;
+  this->minY -= margin;
+  double w = std::ceil((maxX + margin - this->minX) * double(this->scale));
+  double h = std::ceil((maxY + margin - this->minY) * double(this->scale));
+  if (w > maxSide || h > maxSide) {
+    std::cout << "Export would be " << w << "x" << h << " pixels, over the "
+              << maxSide << " pixel limit; use a smaller scale\n";
+    return false;
+  }
+
+  this->width = std::max(1, static_cast<int>(w));
+  this->height = std::max(1, static_cast<int>(h));
+  // Every PNG row starts with its filter type.
+  this->rowBytes = 1 + size_t(this->width) * 3;
+  return true;
+}
+
+void MapExport::layOut(TTF_Font *font, const std::string &fontFile,
+                       int pointSize) {
+  FontMetrics *metrics = FontMetrics::get(font);
+
+  std::vector<std::pair<Node *, std::shared_ptr<const TextLayout>>> laidOut;
+  std::vector<Uint32> codepoints;
+  std::unordered_set<Uint32> seen;
+  uint32_t slots = 0;
+  this->map.nodes.forEach([&](Node *node) {
+    slots = std::max(slots, node->getId().index + 1);
+    const std::string &text = node->getText();
+    if (text.empty())
+      return;
+
+    laidOut.emplace_back(node, LabelCache::get(font, text));
+    for (size_t i = 0; i < text.size();) {
+      Uint32 cp = decodeUtf8(text, i);
+      if (seen.insert(cp).second)
+        codepoints.push_back(cp);
+    }
+  });
+
+  std::vector<SDL_Rect> rects;
+  this->buildSheet(font, fontFile, pointSize, codepoints, rects);
+  if (this->sheetHeight == 0)
+    return;
+
+  std::unordered_map<Uint32, size_t> glyphAt;
+  for (size_t i = 0; i < codepoints.size(); i++)
+    glyphAt[codepoints[i]] = i;
+
+  // Same placement as Node::render and GlyphAtlas::queueText, in world
+  // space.
+  float texel = 1.0f / this->texelScale;
+  float border = GlyphRasterizer::spread * texel;
+  int lineHeight = metrics->getLineHeight();
+
+  this->labels.resize(slots);
+  for (const auto &[node, layout] : laidOut) {
+    Label &label = this->labels[node->getId().index];
+    label.begin = static_cast<uint32_t>(this->quads.size());
+
+    const std::string &text = node->getText();
+    float lineY = node->getY() - layout->getHeight() / 2.0f;
+    for (const auto &line : layout->getLines()) {
+      float penX = node->getX() - (node->isCenteredText()
+                                       ? line.width
+                                       : layout->getWidth()) /
+                                      2.0f;
+      Uint32 prev = 0;
+      for (size_t i = line.begin; i < line.end;) {
+        Uint32 cp = decodeUtf8(text, i);
+        if (prev)
+          penX += metrics->kerning(prev, cp);
+        prev = cp;
+
+        const SDL_Rect &src = rects[glyphAt[cp]];
+        if (src.w > 0) {
+          float x1 = penX - border;
+          float y1 = lineY - border;
+          this->quads.push_back(
+              {x1, y1, x1 + src.w * texel, y1 + src.h * texel,
+               static_cast<float>(src.x) / sheetWidth,
+               static_cast<float>(src.y) / this->sheetHeight,
+               static_cast<float>(src.x + src.w) / sheetWidth,
+               static_cast<float>(src.y + src.h) / this->sheetHeight});
+        }
+        penX += metrics->advance(cp);
+      }
+      lineY += lineHeight;
+    }
+
+    label.end = static_cast<uint32_t>(this->quads.size());
+  }
+}
+
+void MapExport::buildSheet(TTF_Font *font, const std::string &fontFile,
+                           int pointSize,
+                           const std::vector<Uint32> &codepoints,
+                           std::vector<SDL_Rect> &rects) {
+  std::vector<GlyphRasterizer::Field> fields(codepoints.size());
+
+  // Fields come from the rasterizer pool when the font file is known, the
+  // same way the on-screen atlas builds them.
+  std::unique_ptr<GlyphRasterizer> rasterizer;
+  if (!fontFile.empty())
+    rasterizer = std::make_unique<GlyphRasterizer>(
+        fontFile, pointSize * GlyphRasterizer::oversample,
+        GlyphRasterizer::oversample / GlyphRasterizer::texelScale);
+
+  if (rasterizer && rasterizer->isRunning()) {
+    this->texelScale = GlyphRasterizer::texelScale;
+    std::unordered_map<Uint32, size_t> at;
+    for (size_t i = 0; i < codepoints.size(); i++) {
+      at[codepoints[i]] = i;
+      rasterizer->request(codepoints[i]);
+    }
+
+    GlyphRasterizer::Field field;
+    while (rasterizer->takeFinished(field, true))
+      fields[at[field.codepoint]] = std::move(field);
+  } else {
+    for (size_t i = 0; i < codepoints.size(); i++)
+      GlyphRasterizer::build(font, codepoints[i], 1, fields[i]);
+  }
+
+  // Shelf-pack every field into one sheet.
+  rects.assign(codepoints.size(), SDL_Rect{0, 0, 0, 0});
+  int cursorX = 0;
+  int cursorY = 0;
+  int rowHeight = 0;
+  for (size_t i = 0; i < fields.size(); i++) {
+    const GlyphRasterizer::Field &field = fields[i];
+    if (field.data.empty() || field.w + glyphPadding > sheetWidth)
+      continue;
+
+    if (cursorX + field.w + glyphPadding > sheetWidth) {
+      cursorX = 0;
+      cursorY += rowHeight;
+      rowHeight = 0;
+    }
+    rects[i] = {cursorX, cursorY, field.w, field.h};
+    cursorX += field.w + glyphPadding;
+    rowHeight = std::max(rowHeight, field.h + glyphPadding);
+  }
+  this->sheetHeight = cursorY + rowHeight;
+  if (this->sheetHeight == 0)
+    return;
+
+  // Export scale is fixed, so coverage is worked out once, here.
+  uint8_t coverage[256];
+  GlyphRasterizer::coverage(this->scale / this->texelScale, coverage);
+
+  this->sheetPixels.assign(size_t(sheetWidth) * this->sheetHeight,
+                           (Uint32(coverage[0]) << 24) | 0xFFFFFF);
+  for (size_t i = 0; i < fields.size(); i++) {
+    const GlyphRasterizer::Field &field = fields[i];
+    const SDL_Rect &rect = rects[i];
+    for (int y = 0; y < rect.h; y++) {
+      const uint8_t *in = &field.data[size_t(y) * field.w];
+      Uint32 *out =
+          &this->sheetPixels[size_t(rect.y + y) * sheetWidth + rect.x];
+      for (int x = 0; x < rect.w; x++)
+        out[x] = (Uint32(coverage[in[x]]) << 24) | 0xFFFFFF;
+    }
+  }
+}
+
+bool MapExport::write(const std::string &path) {
+  std::ofstream out(path, std::ios::binary);
+  if (!out) {
+    std::cout << "Failed to open " << path << " for writing\n";
+    return false;
+  }
+
+  size_t bandCount = (this->height + tileSize - 1) / tileSize;
+  this->bands.resize(bandCount);
+
+  unsigned threads = std::clamp<unsigned>(std::thread::hardware_concurrency(),
+                                          1, static_cast<unsigned>(bandCount));
+  this->bandsAhead = threads * bandsPerWorker;
+
+  // Renderers are made here rather than on the workers, one per thread.
+  std::vector<Worker> workers(threads);
+  for (Worker &worker : workers) {
+    if (!this->open(worker)) {
+      for (Worker &other : workers)
+        this->close(other);
+      return false;
+    }
+  }
+
+  static const unsigned char signature[8] = {0x89, 'P',  'N',  'G',
+                                             '\r', '\n', 0x1A, '\n'};
+  out.write(reinterpret_cast<const char *>(signature), 8);
+
+  unsigned char header[13];
+  put32(header, this->width);
+  put32(header + 4, this->height);
+  header[8] = 8;  // bits per channel
+  header[9] = 2;  // RGB
+  header[10] = 0; // deflate
+  header[11] = 0; // adaptive filtering
+  header[12] = 0; // not interlaced
+  writeChunk(out, "IHDR", header, sizeof(header));
+
+  // Bands are deflated separately and joined like pigz does: each ends on a
+  // byte boundary, and their checksums combine into the stream's.
+  static const unsigned char zlibHeader[2] = {0x78, 0x9C};
+  writeChunk(out, "IDAT", zlibHeader, sizeof(zlibHeader));
+
+  std::vector<std::thread> running;
+  for (Worker &worker : workers)
+    running.emplace_back(&MapExport::run, this, std::ref(worker));
+
+  uLong adler = adler32(0, Z_NULL, 0);
+  bool ok = true;
+  for (size_t i = 0; i < bandCount; i++) {
+    Band band;
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->progress.wait(
+          lock, [&] { return this->bands[i].done || this->failed; });
+      if (this->failed) {
+        ok = false;
+        break;
+      }
+      band = std::move(this->bands[i]);
+    }
+
+    adler = adler32_combine(adler, band.adler,
+                            static_cast<z_off_t>(band.length));
+    writeChunk(out, "IDAT", band.data.data(), band.data.size());
+    if (!out) {
+      std::cout << "Failed to write " << path << '\n';
+      this->fail();
+      ok = false;
+      break;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->written = i + 1;
+    }
+    this->progress.notify_all();
+  }
+
+  for (std::thread &thread : running)
+    thread.join();
+  for (Worker &worker : workers)
+    this->close(worker);
+
+  if (ok) {
+    unsigned char trailer[4];
+    put32(trailer, static_cast<uint32_t>(adler));
+    writeChunk(out, "IDAT", trailer, sizeof(trailer));
+    writeChunk(out, "IEND", nullptr, 0);
+    out.flush();
+    if (!out) {
+      std::cout << "Failed to write " << path << '\n';
+      ok = false;
+    }
+  }
+
+  if (!ok) {
+    out.close();
+    std::remove(path.c_str());
+  }
+  return ok;
+}
+
+bool MapExport::open(Worker &worker) {
+  worker.surface = SDL_CreateRGBSurfaceWithFormat(0, tileSize, tileSize, 32,
+                                                  SDL_PIXELFORMAT_ARGB8888);
+  if (!worker.surface) {
+    std::cout << "SDL_CreateRGBSurfaceWithFormat failed: " << SDL_GetError()
+              << '\n';
+    return false;
+  }
+
+  worker.renderer = SDL_CreateSoftwareRenderer(worker.surface);
+  if (!worker.renderer) {
+    std::cout << "SDL_CreateSoftwareRenderer failed: " << SDL_GetError()
+              << '\n';
+    return false;
+  }
+  SDL_SetRenderDrawBlendMode(worker.renderer, SDL_BLENDMODE_BLEND);
+
+  if (this->sheetPixels.empty())
+    return true;
+
+  worker.sheet =
+      SDL_CreateTexture(worker.renderer, SDL_PIXELFORMAT_ARGB8888,
+                        SDL_TEXTUREACCESS_STATIC, sheetWidth, this->sheetHeight);
+  if (!worker.sheet) {
+    std::cout << "SDL_CreateTexture failed: " << SDL_GetError() << '\n';
+    return false;
+  }
+  SDL_UpdateTexture(worker.sheet, nullptr, this->sheetPixels.data(),
+                    sheetWidth * 4);
+  SDL_SetTextureBlendMode(worker.sheet, SDL_BLENDMODE_BLEND);
+  return true;
+}
+
+void MapExport::close(Worker &worker) {
+  if (worker.sheet)
+    SDL_DestroyTexture(worker.sheet);
+  if (worker.renderer)
+    SDL_DestroyRenderer(worker.renderer);
+  if (worker.surface)
+    SDL_FreeSurface(worker.surface);
+  worker.sheet = nullptr;
+  worker.renderer = nullptr;
+  worker.surface = nullptr;
+}
+
+void MapExport::fail() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->failed = 1;
+  }
+  this->progress.notify_all();
+}
+
+void MapExport::run(Worker &worker) {
+  std::vector<unsigned char> rows(this->rowBytes * tileSize);
+
+  for (;;) {
+    size_t band;
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      if (this->failed || this->nextBand >= this->bands.size())
+        return;
+      band = this->nextBand++;
+
+      // Stay within reach of the writer so finished bands can't pile up.
+      this->progress.wait(lock, [&] {
+        return this->failed || band < this->written + this->bandsAhead;
+      });
+      if (this->failed)
+        return;
+    }
+
+    int y0 = static_cast<int>(band) * tileSize;
+    int h = std::min(tileSize, this->height - y0);
+    for (int x0 = 0; x0 < this->width; x0 += tileSize) {
+      this->renderTile(worker, x0, y0);
+
+      SDL_Rect rect = {0, 0, std::min(tileSize, this->width - x0), h};
+      if (SDL_RenderReadPixels(worker.renderer, &rect, SDL_PIXELFORMAT_RGB24,
+                               &rows[1 + size_t(x0) * 3],
+                               static_cast<int>(this->rowBytes)) != 0) {
+        std::cout << "SDL_RenderReadPixels failed: " << SDL_GetError()
+                  << '\n';
+        this->fail();
+        return;
+      }
+    }
+
+    Band result;
+    if (!this->compress(rows, size_t(h) * this->rowBytes,
+                        band + 1 == this->bands.size(), result)) {
+      this->fail();
+      return;
+    }
+    result.done = true;
+
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->bands[band] = std::move(result);
+    }
+    this->progress.notify_all();
+  }
+}
+
+void MapExport::renderTile(Worker &worker, int x0, int y0) {
+  SDL_Renderer *renderer = worker.renderer;
+
+  // Screen position is (world + d) * scale, as on screen.
+  float left = this->minX + x0 / this->scale;
+  float top = this->minY + y0 / this->scale;
+  float size = tileSize / this->scale;
+  float dx = -left;
+  float dy = -top;
+  float x1 = left - cullMargin;
+  float y1 = top - cullMargin;
+  float x2 = left + size + cullMargin;
+  float y2 = top + size + cullMargin;
+
+  SDL_RenderSetScale(renderer, 1, 1);
+  SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+  SDL_RenderClear(renderer);
+
+  worker.edgeList.clear();
+  this->map.index.queryEdgesShared(x1, y1, x2, y2, worker.edgeList);
+  worker.edges.begin(dx, dy, this->scale);
+  for (const auto &[from, to] : worker.edgeList)
+    worker.edges.addEdge(from, to);
+  worker.edges.flush(renderer);
+
+  worker.nodes.clear();
+  this->map.index.queryRect(x1, y1, x2, y2, worker.nodes);
+  std::sort(worker.nodes.begin(), worker.nodes.end(),
+            [](const Node *a, const Node *b) {
+              return a->getDrawOrder() < b->getDrawOrder();
+            });
+
+  SDL_RenderSetScale(renderer, this->scale, this->scale);
+
+  // Selection and search halos are view state and stay off the export.
+  worker.circles.begin(this->scale);
+  for (const Node *node : worker.nodes)
+    node->renderShape(worker.circles, dx, dy);
+  worker.circles.flush(renderer);
+
+  if (!worker.sheet)
+    return;
+
+  worker.vertices.clear();
+  worker.indices.clear();
+  for (const Node *node : worker.nodes) {
+    uint32_t index = node->getId().index;
+    if (index >= this->labels.size())
+      continue;
+
+    const Label &label = this->labels[index];
+    SDL_Color color = node->getTxtColor();
+    for (uint32_t i = label.begin; i < label.end; i++) {
+      const Quad &q = this->quads[i];
+      int base = static_cast<int>(worker.vertices.size());
+      worker.vertices.push_back({{q.x1 + dx, q.y1 + dy}, color, {q.u1, q.v1}});
+      worker.vertices.push_back({{q.x2 + dx, q.y1 + dy}, color, {q.u2, q.v1}});
+      worker.vertices.push_back({{q.x2 + dx, q.y2 + dy}, color, {q.u2, q.v2}});
+      worker.vertices.push_back({{q.x1 + dx, q.y2 + dy}, color, {q.u1, q.v2}});
+      worker.indices.insert(worker.indices.end(), {base, base + 1, base + 2,
+                                                   base, base + 2, base + 3});
+    }
+  }
+
+  if (worker.indices.empty())
+    return;
+
+  if (SDL_RenderGeometry(renderer, worker.sheet, worker.vertices.data(),
+                         static_cast<int>(worker.vertices.size()),
+                         worker.indices.data(),
+                         static_cast<int>(worker.indices.size())) != 0) {
+    std::cout << "SDL_RenderGeometry failed: " << SDL_GetError() << '\n';
+  }
+}
+
+bool MapExport::compress(std::vector<unsigned char> &rows, size_t length,
+                         bool last, Band &band) {
+  // Sub filter: each byte less the one a pixel to its left, which turns the
+  // long flat runs of a map into zeros. Right to left, so it works in place.
+  for (size_t at = 0; at < length; at += this->rowBytes) {
+    unsigned char *row = &rows[at];
+    row[0] = 1;
+    for (size_t i = this->rowBytes - 1; i > 3; i--)
+      row[i] = static_cast<unsigned char>(row[i] - row[i - 3]);
+  }
+
+  band.adler = static_cast<uint32_t>(
+      adler32(adler32(0, Z_NULL, 0), rows.data(), static_cast<uInt>(length)));
+  band.length = length;
+
+  z_stream stream = {};
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    std::cout << "deflateInit2 failed\n";
+    return false;
+  }
+
+  // Room for the worst case plus the empty block a sync flush ends with.
+  band.data.resize(deflateBound(&stream, static_cast<uLong>(length)) + 16);
+  stream.next_in = rows.data();
+  stream.avail_in = static_cast<uInt>(length);
+  stream.next_out = band.data.data();
+  stream.avail_out = static_cast<uInt>(band.data.size());
+
+  int result = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+  bool ok = last ? result == Z_STREAM_END
+                 : result == Z_OK && stream.avail_in == 0;
+  band.data.resize(stream.total_out);
+  deflateEnd(&stream);
+
+  if (!ok)
+    std::cout << "deflate failed: " << result << '\n';
+  return ok;
+}
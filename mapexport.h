@@ -0,0 +1,113 @@
+#ifndef MAPEXPORT_H
+#define MAPEXPORT_H
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include "circlebatch.h"
+#include "edgebatch.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Map;
+class Node;
+
+// Renders a whole map to a PNG at a fixed scale, without a window. The
+// image is cut into bands one tile high. Each worker thread takes a band,
+// draws its tiles with a software renderer of its own, then filters and
+// deflates the band itself; the calling thread writes finished bands to the
+// file in order. Memory stays at about a band per worker however large the
+// image gets.
+//
+// Fonts and the label caches can't be shared between threads, so labels are
+// laid out and their glyphs built into one sheet up front. Workers only read
+// the map, which must not change until writePng returns.
+class MapExport {
+public:
+  // fontFile and pointSize are where font was opened from, for the glyphs.
+  static bool writePng(const Map &map, TTF_Font *font,
+                       const std::string &fontFile, int pointSize,
+                       const std::string &path, float scale);
+
+private:
+  // A glyph in world space and where it sits in the sheet.
+  struct Quad {
+    float x1, y1, x2, y2;
+    float u1, v1, u2, v2;
+  };
+
+  // Range of quads drawn for the node in a slot.
+  struct Label {
+    uint32_t begin = 0;
+    uint32_t end = 0;
+  };
+
+  // One band's rows, deflated.
+  struct Band {
+    bool done = false;
+    std::vector<unsigned char> data;
+    uint32_t adler = 1;
+    size_t length = 0;
+  };
+
+  struct Worker {
+    SDL_Surface *surface = nullptr;
+    SDL_Renderer *renderer = nullptr;
+    SDL_Texture *sheet = nullptr;
+
+    EdgeBatch edges;
+    CircleBatch circles;
+    std::vector<Node *> nodes;
+    std::vector<std::pair<Node *, Node *>> edgeList;
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int> indices;
+  };
+
+  MapExport(const Map &map, float scale);
+
+  bool measure();
+  void layOut(TTF_Font *font, const std::string &fontFile, int pointSize);
+  void buildSheet(TTF_Font *font, const std::string &fontFile, int pointSize,
+                  const std::vector<Uint32> &codepoints,
+                  std::vector<SDL_Rect> &rects);
+  bool write(const std::string &path);
+
+  void run(Worker &worker);
+  bool open(Worker &worker);
+  void close(Worker &worker);
+  void renderTile(Worker &worker, int x0, int y0);
+  bool compress(std::vector<unsigned char> &rows, size_t length, bool last,
+                Band &band);
+  void fail();
+
+  const Map &map;
+  float scale;
+
+  // World position of the image's top left corner, and its size in pixels.
+  float minX = 0;
+  float minY = 0;
+  int width = 0;
+  int height = 0;
+  size_t rowBytes = 0;
+
+  int texelScale = 1;
+  std::vector<Quad> quads;
+  std::vector<Label> labels;
+  // Coverage per texel, white, ready to upload once per worker.
+  std::vector<Uint32> sheetPixels;
+  int sheetHeight = 0;
+
+  std::mutex mutex;
+  std::condition_variable progress;
+  std::vector<Band> bands;
+  size_t nextBand = 0;
+  size_t written = 0;
+  size_t bandsAhead = 1;
+  bool failed = 0;
+};
+
+#endif
@@ -0,0 +1,204 @@
+#include "mapop.h"
+#include <cstring>
+
+template <class T> static void put(std::vector<char> &out, T value) {
+  const char *bytes = reinterpret_cast<const char *>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <class T> static bool take(const char *&at, const char *end, T &value) {
+  if (static_cast<size_t>(end - at) < sizeof(T))
+    return false;
+  std::memcpy(&value, at, sizeof(T));
+  at += sizeof(T);
+  return true;
+}
+
+static void putId(std::vector<char> &out, NodeId id) {
+  put(out, id.index);
+  put(out, id.generation);
+}
+
+static bool takeId(const char *&at, const char *end, NodeId &id) {
+  return take(at, end, id.index) && take(at, end, id.generation);
+}
+
+static void putText(std::vector<char> &out, const std::string &text) {
+  put(out, static_cast<uint32_t>(text.size()));
+  out.insert(out.end(), text.begin(), text.end());
+}
+
+static bool takeText(const char *&at, const char *end, std::string &text) {
+  uint32_t length;
+  if (!take(at, end, length) || static_cast<size_t>(end - at) < length)
+    return false;
+  text.assign(at, length);
+  at += length;
+  return true;
+}
+
+static void putIds(std::vector<char> &out, const std::vector<NodeId> &ids) {
+  put(out, static_cast<uint32_t>(ids.size()));
+  for (NodeId id : ids)
+    putId(out, id);
+}
+
+static bool takeIds(const char *&at, const char *end,
+                    std::vector<NodeId> &ids) {
+  uint32_t count;
+  if (!take(at, end, count) ||
+      static_cast<size_t>(end - at) / (2 * sizeof(uint32_t)) < count)
+    return false;
+  ids.resize(count);
+  for (NodeId &id : ids)
+    takeId(at, end, id);
+  return true;
+}
+
+static bool takeFlag(const char *&at, const char *end, bool &flag) {
+  uint8_t value;
+  if (!take(at, end, value))
+    return false;
+  flag = value;
+  return true;
+}
+
+void MapOp::encode(std::vector<char> &out, bool withUndo) const {
+  put<uint8_t>(out, this->type);
+  putId(out, this->node);
+
+  switch (this->type) {
+  case Create:
+  case Translate:
+    put(out, this->x);
+    put(out, this->y);
+    break;
+  case Destroy:
+    if (withUndo) {
+      put(out, this->x);
+      put(out, this->y);
+      put(out, this->color);
+      put(out, this->textColor);
+      put<uint8_t>(out, this->flag);
+      put<uint8_t>(out, this->oldFlag);
+      put<uint8_t>(out, this->centeredText);
+      putText(out, this->text);
+      putIds(out, this->parents);
+      putIds(out, this->children);
+    }
+    break;
+  case SetText:
+    putText(out, this->text);
+    if (withUndo)
+      putText(out, this->oldText);
+    break;
+  case SetBgColor:
+  case SetTxtColor:
+    put(out, this->color);
+    if (withUndo)
+      put(out, this->oldColor);
+    break;
+  case SetRoot:
+  case SetPinned:
+  case SetCenteredText:
+    put<uint8_t>(out, this->flag);
+    if (withUndo)
+      put<uint8_t>(out, this->oldFlag);
+    break;
+  case AddEdge:
+  case RemoveEdge:
+    putId(out, this->other);
+    break;
+  case Move:
+    put(out, this->x);
+    put(out, this->y);
+    if (withUndo) {
+      put(out, this->oldX);
+      put(out, this->oldY);
+    }
+    break;
+  case Clear:
+    if (withUndo) {
+      putIds(out, this->parents);
+      putIds(out, this->children);
+    }
+    break;
+  }
+}
+
+bool MapOp::decode(const char *&at, const char *end, MapOp &op,
+                   bool withUndo) {
+  uint8_t type;
+  if (!take(at, end, type) || type > SetCenteredText)
+    return false;
+  op.type = static_cast<Type>(type);
+
+  if (!takeId(at, end, op.node))
+    return false;
+
+  switch (op.type) {
+  case Create:
+  case Translate:
+    return take(at, end, op.x) && take(at, end, op.y);
+  case Destroy:
+    return !withUndo ||
+           (take(at, end, op.x) && take(at, end, op.y) &&
+            take(at, end, op.color) && take(at, end, op.textColor) &&
+            takeFlag(at, end, op.flag) && takeFlag(at, end, op.oldFlag) &&
+            takeFlag(at, end, op.centeredText) &&
+            takeText(at, end, op.text) && takeIds(at, end, op.parents) &&
+            takeIds(at, end, op.children));
+  case SetText:
+    return takeText(at, end, op.text) &&
+           (!withUndo || takeText(at, end, op.oldText));
+  case SetBgColor:
+  case SetTxtColor:
+    return take(at, end, op.color) &&
+           (!withUndo || take(at, end, op.oldColor));
+  case SetRoot:
+  case SetPinned:
+  case SetCenteredText:
+    return takeFlag(at, end, op.flag) &&
+           (!withUndo || takeFlag(at, end, op.oldFlag));
+  case AddEdge:
+  case RemoveEdge:
+    return takeId(at, end, op.other);
+  case Move:
+    return take(at, end, op.x) && take(at, end, op.y) &&
+           (!withUndo || (take(at, end, op.oldX) && take(at, end, op.oldY)));
+  case Clear:
+    return !withUndo ||
+           (takeIds(at, end, op.parents) && takeIds(at, end, op.children));
+  }
+  return false;
+}
+
+bool MapOp::merge(const MapOp &next) {
+  if (next.type != this->type || next.node != this->node)
+    return false;
+
+  switch (this->type) {
+  case SetText:
+    this->text = next.text;
+    return true;
+  case SetBgColor:
+  case SetTxtColor:
+    this->color = next.color;
+    return true;
+  case SetRoot:
+  case SetPinned:
+  case SetCenteredText:
+    this->flag = next.flag;
+    return true;
+  case Move:
+    this->x = next.x;
+    this->y = next.y;
+    return true;
+  case Translate:
+    this->x += next.x;
+    this->y += next.y;
+    return true;
+  default:
+    return false;
+  }
+}
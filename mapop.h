@@ -0,0 +1,63 @@
+#ifndef MAPOP_H
+#define MAPOP_H
+
+#include "node.h"
+#include <SDL2/SDL.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One mutation of the map, as reported by Node through Map::record. Only
+// the fields the type names are meaningful.
+//
+// The old* fields, and for Destroy and Clear everything needed to put the
+// node back, describe the state before the op. The journal only stores
+// the forward half; undo stores both.
+struct MapOp {
+  enum Type : uint8_t {
+    Create,          // node at x, y
+    Destroy,         // node, last seen at x, y with text, colours, flags, edges
+    SetText,         // node's text, was oldText
+    SetBgColor,      // node's color, was oldColor
+    SetRoot,         // node's flag, was oldFlag
+    AddEdge,         // node is the parent, other the child
+    RemoveEdge,      // node is the parent, other the child
+    Move,            // node to x, y from oldX, oldY
+    Translate,       // node and its descendants by x, y
+    Clear,           // every edge touching node, were parents and children
+    SetPinned,       // node's flag, was oldFlag
+    SetTxtColor,     // node's text colour in color, was oldColor
+    SetCenteredText, // node's flag, was oldFlag
+  };
+
+  Type type;
+  NodeId node;
+  NodeId other;
+  float x = 0;
+  float y = 0;
+  SDL_Color color = {};
+  bool flag = 0;
+  std::string text;
+
+  float oldX = 0;
+  float oldY = 0;
+  SDL_Color oldColor = {};
+  bool oldFlag = 0;
+  std::string oldText;
+  SDL_Color textColor = {};
+  bool centeredText = 1;
+  std::vector<NodeId> parents;
+  std::vector<NodeId> children;
+
+  // Packs the op into out, with the before-state only if withUndo is set.
+  // decode reads one op back and advances at past it.
+  void encode(std::vector<char> &out, bool withUndo) const;
+  static bool decode(const char *&at, const char *end, MapOp &op,
+                     bool withUndo);
+
+  // Folds a later op on the same node into this one, so a drag or a burst
+  // of typing becomes a single op. Returns false if they don't combine.
+  bool merge(const MapOp &next);
+};
+
+#endif
@@ -0,0 +1,66 @@
+#include "mapsaver.h"
+#include "map.h"
+#include "mindfile.h"
+
+MapSaver::MapSaver() : worker(&MapSaver::run, this) {}
+
+MapSaver::~MapSaver() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = 1;
+  }
+  this->wake.notify_one();
+  this->worker.join();
+}
+
+void MapSaver::save(const Map &map, const std::string &filename,
+                    std::function<void(bool)> done) {
+  Job job{filename, MindFile::snapshot(map), std::move(done)};
+  bool replaced;
+
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    replaced = this->hasPending;
+    std::swap(this->pending, job);
+    this->hasPending = 1;
+    this->state = State::Saving;
+  }
+  this->wake.notify_one();
+
+  if (replaced && job.done)
+    job.done(false);
+}
+
+MapSaver::State MapSaver::getState() const { return this->state; }
+
+float MapSaver::getProgress() const {
+  size_t total = this->total;
+  if (total == 0)
+    return 0;
+  return static_cast<float>(this->written) / total;
+}
+
+void MapSaver::run() {
+  std::unique_lock<std::mutex> lock(this->mutex);
+  for (;;) {
+    this->wake.wait(lock, [this] { return this->hasPending || this->stopping; });
+    if (!this->hasPending)
+      return;
+
+    Job job = std::move(this->pending);
+    this->hasPending = 0;
+    lock.unlock();
+
+    this->written = 0;
+    this->total = job.image.size();
+    bool ok = MindFile::write(job.filename, job.image,
+                              [this](size_t n) { this->written = n; });
+    if (job.done)
+      job.done(ok);
+
+    lock.lock();
+    // A newer save queued meanwhile keeps the state at Saving.
+    if (!this->hasPending)
+      this->state = ok ? State::Saved : State::Failed;
+  }
+}
@@ -0,0 +1,62 @@
+#ifndef MAPSAVER_H
+#define MAPSAVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Map;
+
+// Saves maps off the UI thread. save() copies the map into a MindFile image
+// on the caller's thread, which is all the worker ever reads, so editing can
+// carry on while the image is written out. A save requested while another
+// is running replaces any save still waiting behind it.
+//
+// done, if given, runs on the worker with the outcome once the file is
+// written, or with false straight away if a newer save replaces it first.
+class MapSaver {
+public:
+  enum class State { Idle, Saving, Saved, Failed };
+
+  MapSaver();
+  MapSaver(const MapSaver &) = delete;
+  MapSaver &operator=(const MapSaver &) = delete;
+  // Finishes any queued save before returning.
+  ~MapSaver();
+
+  void save(const Map &map, const std::string &filename,
+            std::function<void(bool)> done = nullptr);
+
+  State getState() const;
+  // Fraction of the current save written, from 0 to 1.
+  float getProgress() const;
+
+private:
+  struct Job {
+    std::string filename;
+    std::vector<char> image;
+    std::function<void(bool)> done;
+  };
+
+  void run();
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  Job pending;
+  bool hasPending = 0;
+  bool stopping = 0;
+
+  std::atomic<State> state{State::Idle};
+  std::atomic<size_t> written{0};
+  std::atomic<size_t> total{0};
+
+  // Last, so it starts after everything run touches.
+  std::thread worker;
+};
+
+#endif
@@ -0,0 +1,350 @@
+#include "mindfile.h"
+#include "legacy.h"
+#include "map.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+static const char mindMagic[4] = {'M', 'I', 'N', 'D'};
+
+// Slot indices are kept on load, and the store allocates every slot below
+// the highest one. Deleting nodes leaves holes, but a file whose indices run
+// past twice its node count plus this many is treated as corrupt rather
+// than allowed to allocate gigabytes.
+static constexpr uint64_t indexSlack = 1 << 16;
+
+// Saves report progress after each chunk written.
+static constexpr size_t writeChunk = 1 << 20;
+
+static_assert(sizeof(MindHeader) == 96, "MindHeader layout changed");
+static_assert(sizeof(MindNodeRecord) == 40, "MindNodeRecord layout changed");
+static_assert(sizeof(MindEdgeRecord) == 8, "MindEdgeRecord layout changed");
+
+static uint64_t align8(uint64_t n) { return (n + 7) & ~static_cast<uint64_t>(7); }
+
+std::vector<char> MindFile::snapshot(const Map &map) {
+  std::vector<Node *> sorted;
+  sorted.reserve(map.nodes.size());
+  map.nodes.forEach([&](Node *node) { sorted.push_back(node); });
+  std::sort(sorted.begin(), sorted.end(), [](const Node *a, const Node *b) {
+    return a->getDrawOrder() < b->getDrawOrder();
+  });
+
+  std::unordered_map<uint32_t, uint32_t> position;
+  position.reserve(sorted.size());
+  uint64_t stringSize = 0;
+  uint64_t edgeCount = 0;
+  for (uint32_t i = 0; i < sorted.size(); i++) {
+    position[sorted[i]->id.index] = i;
+    stringSize += sorted[i]->text.size();
+    edgeCount += sorted[i]->children.size();
+  }
+
+  MindHeader header = {};
+  std::memcpy(header.magic, mindMagic, sizeof(mindMagic));
+  header.version = version;
+  header.nodeCount = static_cast<uint32_t>(sorted.size());
+  header.edgeCount = static_cast<uint32_t>(edgeCount);
+  header.nodeOffset = sizeof(MindHeader);
+  header.edgeOffset = header.nodeOffset + sorted.size() * sizeof(MindNodeRecord);
+  header.stringOffset = header.edgeOffset + edgeCount * sizeof(MindEdgeRecord);
+  header.stringSize = stringSize;
+  header.dx = map.dx;
+  header.dy = map.dy;
+  header.journalSequence = map.journalSequence;
+  header.currentNode = UINT32_MAX;
+  if (Node *current = map.current())
+    header.currentNode = position[current->id.index];
+
+  std::vector<char> image(align8(header.stringOffset + stringSize), 0);
+  std::memcpy(image.data(), &header, sizeof(header));
+
+  auto *nodes =
+      reinterpret_cast<MindNodeRecord *>(image.data() + header.nodeOffset);
+  auto *edges =
+      reinterpret_cast<MindEdgeRecord *>(image.data() + header.edgeOffset);
+  char *strings = image.data() + header.stringOffset;
+
+  uint32_t textOffset = 0;
+  uint32_t edge = 0;
+  for (uint32_t i = 0; i < sorted.size(); i++) {
+    const Node *node = sorted[i];
+    MindNodeRecord &record = nodes[i];
+
+    record.index = node->id.index;
+    record.generation = node->id.generation;
+    record.x = node->x;
+    record.y = node->y;
+    record.radius = node->radius;
+    record.textOffset = textOffset;
+    record.textLength = static_cast<uint32_t>(node->text.size());
+    record.textColor[0] = node->textColor.r;
+    record.textColor[1] = node->textColor.g;
+    record.textColor[2] = node->textColor.b;
+    record.textColor[3] = node->textColor.a;
+    record.bgColor[0] = node->bgColor.r;
+    record.bgColor[1] = node->bgColor.g;
+    record.bgColor[2] = node->bgColor.b;
+    record.bgColor[3] = node->bgColor.a;
+    record.flags = (node->root ? nodeRoot : 0) |
+                   (node->centeredText ? nodeCenteredText : 0) |
+                   (node->pinned ? nodePinned : 0);
+
+    std::memcpy(strings + textOffset, node->text.data(), node->text.size());
+    textOffset += record.textLength;
+
+    for (uint32_t child : node->children)
+      edges[edge++] = {i, position[child]};
+  }
+
+  return image;
+}
+
+bool MindFile::write(const std::string &filename,
+                     const std::vector<char> &image,
+                     const std::function<void(size_t)> &progress) {
+  // Write beside the target and rename over it, so a crash mid-save leaves
+  // the previous file intact.
+  std::string temp = filename + ".tmp";
+  int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    std::cout << "Failed to open " << temp << " for writing: "
+              << strerror(errno) << '\n';
+    return false;
+  }
+
+  auto fail = [&](const char *what) {
+    std::cout << what << " failed for " << temp << ": " << strerror(errno)
+              << '\n';
+    close(fd);
+    unlink(temp.c_str());
+    return false;
+  };
+
+  size_t written = 0;
+  while (written < image.size()) {
+    size_t chunk = std::min(image.size() - written, writeChunk);
+    ssize_t n = ::write(fd, image.data() + written, chunk);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return fail("write");
+    }
+    written += static_cast<size_t>(n);
+    if (progress)
+      progress(written);
+  }
+
+  if (fsync(fd) != 0)
+    return fail("fsync");
+  if (close(fd) != 0) {
+    std::cout << "close failed for " << temp << ": " << strerror(errno)
+              << '\n';
+    unlink(temp.c_str());
+    return false;
+  }
+
+  if (rename(temp.c_str(), filename.c_str()) != 0) {
+    std::cout << "Failed to rename " << temp << " to " << filename << ": "
+              << strerror(errno) << '\n';
+    unlink(temp.c_str());
+    return false;
+  }
+
+  // Persist the rename itself.
+  size_t slash = filename.find_last_of('/');
+  std::string dir = slash == std::string::npos ? "." : filename.substr(0, slash);
+  int dirFd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (dirFd >= 0) {
+    fsync(dirFd);
+    close(dirFd);
+  }
+  return true;
+}
+
+bool MindFile::isMindFile(const std::string &filename) {
+  std::ifstream ifs(filename, std::ios::binary);
+  char magic[4] = {};
+  ifs.read(magic, sizeof(magic));
+  return ifs && std::memcmp(magic, mindMagic, sizeof(mindMagic)) == 0;
+}
+
+bool MindFile::load(Map &map, const std::string &filename, TTF_Font *font) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cout << "Failed to open " << filename << ": " << strerror(errno)
+              << '\n';
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(MindHeader))) {
+    std::cout << filename << " is too short to be a .mind file\n";
+    close(fd);
+    return false;
+  }
+
+  size_t size = static_cast<size_t>(st.st_size);
+  void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (mapping == MAP_FAILED) {
+    std::cout << "mmap failed for " << filename << ": " << strerror(errno)
+              << '\n';
+    return false;
+  }
+
+  const char *data = static_cast<const char *>(mapping);
+  const auto *header = reinterpret_cast<const MindHeader *>(data);
+
+  auto fail = [&](const char *reason) {
+    std::cout << "Failed to load " << filename << ": " << reason << '\n';
+    munmap(mapping, size);
+    return false;
+  };
+
+  if (std::memcmp(header->magic, mindMagic, sizeof(mindMagic)) != 0)
+    return fail("not a .mind file");
+  if (header->version > version)
+    return fail("written by a newer version");
+  if (header->nodeOffset % 8 || header->edgeOffset % 8 ||
+      header->nodeOffset > size ||
+      (size - header->nodeOffset) / sizeof(MindNodeRecord) <
+          header->nodeCount ||
+      header->edgeOffset > size ||
+      (size - header->edgeOffset) / sizeof(MindEdgeRecord) <
+          header->edgeCount ||
+      header->stringOffset > size ||
+      size - header->stringOffset < header->stringSize)
+    return fail("tables run past the end of the file");
+
+  const auto *nodes =
+      reinterpret_cast<const MindNodeRecord *>(data + header->nodeOffset);
+  const auto *edges =
+      reinterpret_cast<const MindEdgeRecord *>(data + header->edgeOffset);
+  const char *strings = data + header->stringOffset;
+
+  uint64_t indexLimit = 2 * uint64_t(header->nodeCount) + indexSlack;
+  std::vector<bool> used(std::min<uint64_t>(indexLimit, UINT32_MAX));
+  for (uint32_t i = 0; i < header->nodeCount; i++) {
+    const MindNodeRecord &record = nodes[i];
+    if (record.index >= used.size() || used[record.index] ||
+        record.textOffset > header->stringSize ||
+        header->stringSize - record.textOffset < record.textLength)
+      return fail("corrupt node table");
+    used[record.index] = 1;
+  }
+
+  std::vector<uint64_t> pairs;
+  pairs.reserve(header->edgeCount);
+  for (uint32_t i = 0; i < header->edgeCount; i++) {
+    if (edges[i].parent >= header->nodeCount ||
+        edges[i].child >= header->nodeCount)
+      return fail("corrupt edge table");
+    pairs.push_back(uint64_t(edges[i].parent) << 32 | edges[i].child);
+  }
+  std::sort(pairs.begin(), pairs.end());
+  if (std::adjacent_find(pairs.begin(), pairs.end()) != pairs.end())
+    return fail("duplicate edge");
+
+  map.currentNode = NodeId();
+  map.nodes.clear();
+  map.order.clear();
+  map.index.clear();
+  map.search.clear();
+
+  std::vector<Node *> created(header->nodeCount, nullptr);
+  for (uint32_t i = 0; i < header->nodeCount; i++) {
+    const MindNodeRecord &record = nodes[i];
+
+    Node *node = map.nodes.createAt({record.index, record.generation},
+                                    record.x, record.y, font);
+    if (!node)
+      node = map.nodes.create(record.x, record.y, font);
+
+    node->textColor = {record.textColor[0], record.textColor[1],
+                       record.textColor[2], record.textColor[3]};
+    node->bgColor = {record.bgColor[0], record.bgColor[1], record.bgColor[2],
+                     record.bgColor[3]};
+    node->root = record.flags & nodeRoot;
+    node->centeredText = record.flags & nodeCenteredText;
+    node->pinned = record.flags & nodePinned;
+    node->restoreText(
+        std::string(strings + record.textOffset, record.textLength),
+        record.radius);
+
+    map.order.insert(node->id.index);
+    created[i] = node;
+  }
+
+  for (uint32_t i = 0; i < header->edgeCount; i++) {
+    Node *parent = created[edges[i].parent];
+    Node *child = created[edges[i].child];
+    if (parent == child)
+      continue;
+    parent->children.push_back(child->id.index);
+    child->parents.push_back(parent->id.index);
+  }
+
+  // Files written by this build are acyclic; anything else is relinked
+  // edge by edge so the cycle check can drop the offenders.
+  if (!map.order.rebuild()) {
+    for (Node *node : created) {
+      node->parents.clear();
+      node->children.clear();
+    }
+    map.order.clear();
+    for (Node *node : created)
+      map.order.insert(node->id.index);
+    for (uint32_t i = 0; i < header->edgeCount; i++)
+      created[edges[i].child]->addParent(created[edges[i].parent]);
+  }
+
+  for (Node *node : created) {
+    for (uint32_t index : node->children) {
+      Node *child = map.nodes.at(index);
+      map.index.updateEdge(node, child, node->x, node->y, child->x, child->y);
+    }
+  }
+
+  if (header->currentNode < header->nodeCount)
+    map.currentNode = created[header->currentNode]->id;
+
+  map.dx = header->dx;
+  map.dy = header->dy;
+  map.journalSequence = header->journalSequence;
+
+  munmap(mapping, size);
+  return true;
+}
+
+bool MindFile::convertLegacy(const std::string &from, const std::string &to) {
+  Map map;
+  Map *previous = Map::curMap;
+  Map::curMap = &map;
+
+  bool ok = true;
+  try {
+    LegacyMap legacy;
+    std::ifstream ifs(from, std::ios::binary);
+    boost::archive::binary_iarchive ia(ifs);
+    ia >> legacy;
+    legacy.toMap(map, nullptr);
+  } catch (const std::exception &e) {
+    std::cout << "Failed to read legacy archive " << from << ": " << e.what()
+              << '\n';
+    ok = false;
+  }
+
+  if (ok)
+    ok = write(to, snapshot(map));
+
+  Map::curMap = previous;
+  return ok;
+}
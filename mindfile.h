@@ -0,0 +1,78 @@
+#ifndef MINDFILE_H
+#define MINDFILE_H
+
+#include <SDL2/SDL_ttf.h>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class Map;
+
+// Native .mind layout, all little-endian and 8-byte aligned so the tables
+// can be used straight out of an mmap:
+//
+//   MindHeader
+//   MindNodeRecord[nodeCount]   in draw order
+//   MindEdgeRecord[edgeCount]   parent/child as node table positions
+//   string pool                 node labels, UTF-8, not terminated
+//
+// Nodes keep their NodeId across a save/load round trip, so journal records
+// written after the snapshot still name the right nodes.
+struct MindHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t nodeCount;
+  uint32_t edgeCount;
+  uint64_t nodeOffset;
+  uint64_t edgeOffset;
+  uint64_t stringOffset;
+  uint64_t stringSize;
+  float dx;
+  float dy;
+  uint32_t currentNode;
+  uint32_t flags;
+  // Last journal operation reflected in this file; 0 before journaling.
+  uint64_t journalSequence;
+  uint64_t reserved[3];
+};
+
+struct MindNodeRecord {
+  uint32_t index;
+  uint32_t generation;
+  float x;
+  float y;
+  float radius;
+  uint32_t textOffset;
+  uint32_t textLength;
+  uint8_t textColor[4];
+  uint8_t bgColor[4];
+  uint32_t flags;
+};
+
+struct MindEdgeRecord {
+  uint32_t parent;
+  uint32_t child;
+};
+
+class MindFile {
+public:
+  static constexpr uint32_t version = 1;
+
+  static constexpr uint32_t nodeRoot = 1 << 0;
+  static constexpr uint32_t nodeCenteredText = 1 << 1;
+  static constexpr uint32_t nodePinned = 1 << 2;
+
+  static std::vector<char> snapshot(const Map &map);
+  // Replaces filename atomically via a synced temp file. progress, if set,
+  // is called with the number of bytes written so far.
+  static bool write(const std::string &filename,
+                    const std::vector<char> &image,
+                    const std::function<void(size_t)> &progress = nullptr);
+  static bool load(Map &map, const std::string &filename, TTF_Font *font);
+
+  static bool isMindFile(const std::string &filename);
+  static bool convertLegacy(const std::string &from, const std::string &to);
+};
+
+#endif
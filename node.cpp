@@ -1,16 +1,42 @@
 #include "node.h"
+#include "glyphatlas.h"
+#include "labelcache.h"
 #include "map.h"
-#include <SDL2/SDL2_gfxPrimitives.h>
+#include "profiler.h"
 #include <SDL2/SDL_ttf.h>
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <iostream>
 
-BOOST_CLASS_EXPORT_IMPLEMENT(Node);
+// Auto-layout velocity decay per second, and the speed cap in world units
+// per second that keeps a freshly started layout from flinging nodes away.
+static constexpr float layoutFriction = 6;
+static constexpr float layoutMaxSpeed = 3000;
 
-std::shared_ptr<Node> Node::create(float x, float y, TTF_Font *font) {
-  auto node = std::shared_ptr<Node>(new Node(x, y, font));
-  Map::curMap->nodes.push_back(node);
+static Node *nodeAt(uint32_t index) { return Map::curMap->nodes.at(index); }
+
+static void record(MapOp op) { Map::curMap->record(op); }
+
+static bool eraseIndex(std::vector<uint32_t> &list, uint32_t index) {
+  auto it = std::find(list.begin(), list.end(), index);
+  if (it == list.end())
+    return false;
+
+  list.erase(it);
+  return true;
+}
+
+Node *Node::create(float x, float y, TTF_Font *font) {
+  Node *node = Map::curMap->nodes.create(x, y, font);
+  Map::curMap->order.insert(node->id.index);
+  Map::curMap->index.insert(node, x, y, node->radius);
+  Map::curMap->search.set(node->id.index, node->text);
+
+  MapOp op{MapOp::Create, node->id};
+  op.x = x;
+  op.y = y;
+  record(op);
   return node;
 }
 
@@ -22,381 +48,437 @@ Node::Node(float x, float y, TTF_Font *font) : x(x), y(y), font(font) {
 }
 
 void Node::destruct() {
-  try {
-    if (auto self = shared_from_this()) {
-
-      std::vector<std::shared_ptr<Node>> parentsCopy = this->parents;
-      for (const auto &parent : parentsCopy) {
-        if(parent) {
-          parent->removeNode(self);
-        }
-      }
-
-      std::vector<std::shared_ptr<Node>> childrenCopy = this->children;
-        for (const auto &child : childrenCopy) {
-          if(child) {
-             child->removeParent(self);
-          }
-        }
-
-      std::vector<int> parentNodeIndicesToErase;
-      for (int i = 0; i < Map::curMap->parentNodes.size(); i++) {
-        if (Map::curMap->parentNodes[i] == self) {
-          parentNodeIndicesToErase.push_back(i);
-        }
-      }
-      for (int i = parentNodeIndicesToErase.size() - 1; i >= 0; --i) {
-        Map::curMap->parentNodes.erase(Map::curMap->parentNodes.begin() + parentNodeIndicesToErase[i]);
-      }
-
-      std::vector<int> nodeIndicesToErase;
-      for (int i = 0; i < Map::curMap->nodes.size(); i++) {
-        if (Map::curMap->nodes[i] == self) {
-          nodeIndicesToErase.push_back(i);
-        }
-      }
-      for (int i = nodeIndicesToErase.size() - 1; i >= 0; --i) {
-        Map::curMap->nodes.erase(Map::curMap->nodes.begin() + nodeIndicesToErase[i]);
-      }
-    } else {
-      std::cout << "Error: shared_from_this() failed\n";
-    }
-  } catch (const std::bad_weak_ptr &e) {
-    std::cout << "shared_from_this failed: " << e.what() << '\n';
+  MapOp op{MapOp::Destroy, this->id};
+  op.x = this->x;
+  op.y = this->y;
+  op.color = this->bgColor;
+  op.textColor = this->textColor;
+  op.flag = this->root;
+  op.oldFlag = this->pinned;
+  op.centeredText = this->centeredText;
+  op.text = this->text;
+  for (uint32_t index : this->parents)
+    op.parents.push_back(nodeAt(index)->id);
+  for (uint32_t index : this->children)
+    op.children.push_back(nodeAt(index)->id);
+  record(op);
+
+  Map::curMap->index.remove(this);
+  Map::curMap->search.remove(this->id.index);
+
+  for (uint32_t index : this->parents) {
+    Node *parent = nodeAt(index);
+    eraseIndex(parent->children, this->id.index);
+    Map::curMap->index.removeEdge(parent, this);
   }
+
+  for (uint32_t index : this->children) {
+    Node *child = nodeAt(index);
+    eraseIndex(child->parents, this->id.index);
+    Map::curMap->index.removeEdge(this, child);
+  }
+
+  if (Map::curMap->currentNode == this->id)
+    Map::curMap->currentNode = NodeId();
+
+  // Releases this node's slot; nothing may touch `this` afterwards.
+  Map::curMap->nodes.destroy(this);
 }
 
+NodeId Node::getId() const { return this->id; }
+
 SDL_Color Node::getBgColor() const { return this->bgColor; }
 SDL_Color Node::getTxtColor() const { return this->textColor; }
 
 void Node::setBgColor(int r, int g, int b) {
+  SDL_Color old = this->bgColor;
+
   if (r >= 0 && r <= 255)
     this->bgColor.r = r;
   if (g >= 0 && g <= 255)
     this->bgColor.g = g;
   if (b >= 0 && b <= 255)
     this->bgColor.b = b;
+
+  MapOp op{MapOp::SetBgColor, this->id};
+  op.color = this->bgColor;
+  op.oldColor = old;
+  record(op);
+}
+
+void Node::setTxtColor(SDL_Color color) {
+  MapOp op{MapOp::SetTxtColor, this->id};
+  op.color = color;
+  op.oldColor = this->textColor;
+
+  this->textColor = color;
+  record(op);
 }
 
 float Node::getX() const { return this->x; }
 float Node::getY() const { return this->y; }
 
-void Node::setX(float x) { this->x = x; }
-void Node::setY(float y) { this->y = y; }
-
-void Node::setXRec(float x) {
-  for (const auto& node : this->children) {
-    node->setXRec(node->getX() - this->x + x);
-  }
+void Node::setX(float x) {
+  if (x == this->x)
+    return;
 
+  float old = this->x;
   this->x = x;
+  reindex();
+  recordMove(old, this->y);
 }
 
-void Node::setYRec(float y) {
-  for (const auto& node : this->children) {
-    node->setYRec(node->getY() - this->y + y);
-  }
+void Node::setY(float y) {
+  if (y == this->y)
+    return;
 
+  float old = this->y;
   this->y = y;
+  reindex();
+  recordMove(this->x, old);
 }
 
-float Node::getRadius() const { return this->radius; }
-
-void Node::addNode(std::shared_ptr<Node> node) {
-
-  this->children.push_back(node);
+void Node::recordMove(float oldX, float oldY) const {
+  MapOp op{MapOp::Move, this->id};
+  op.x = this->x;
+  op.y = this->y;
+  op.oldX = oldX;
+  op.oldY = oldY;
+  record(op);
 }
 
-void Node::removeNode(std::shared_ptr<Node> node) {
-  for (int i = 0; i < children.size(); i++)
-    if (children[i] == node) {
-      children.erase(children.begin() + i);
-    }
+void Node::setXRec(float x) { translateRec(x - this->x, 0); }
+void Node::setYRec(float y) { translateRec(0, y - this->y); }
+
+void Node::setPosRec(float x, float y) {
+  translateRec(x - this->x, y - this->y);
 }
 
-void Node::toggleParent(std::shared_ptr<Node> node) {
-  if (node == shared_from_this())
+void Node::translateRec(float dx, float dy) {
+  if (dx == 0 && dy == 0)
     return;
 
-  bool exists = 0;
+  MapOp op{MapOp::Translate, this->id};
+  op.x = dx;
+  op.y = dy;
+  record(op);
 
-  for (int i = 0; i < this->parents.size(); i++) {
-    if (this->parents[i] == node) {
-      this->parents[i]->removeNode(shared_from_this());
-      this->parents.erase(this->parents.begin() + i);
-      exists = 1;
-    }
-  }
+  // Shared descendants in a diamond are moved once, not once per path.
+  const std::vector<uint32_t> &subtree =
+      Map::curMap->order.descendants(this->id.index);
 
-  if (!exists) {
-    this->parents.push_back(node);
-    node->addNode(shared_from_this());
+  for (uint32_t index : subtree) {
+    Node *node = nodeAt(index);
+    node->x += dx;
+    node->y += dy;
   }
-}
 
-void Node::addParent(std::shared_ptr<Node> node) {
-  if (node == shared_from_this())
-    return;
+  for (uint32_t index : subtree)
+    nodeAt(index)->reindex();
+}
 
-  for (const auto &parent : this->parents)
-    if (parent == node)
-      return;
+float Node::getRadius() const { return this->radius; }
+unsigned int Node::getDrawOrder() const { return this->drawOrder; }
 
-  this->parents.push_back(node);
-  node->addNode(shared_from_this());
-}
+bool Node::isRoot() const { return this->root; }
+void Node::setRoot(bool root) {
+  MapOp op{MapOp::SetRoot, this->id};
+  op.flag = root;
+  op.oldFlag = this->root;
 
-void Node::removeParent(std::shared_ptr<Node> node) {
-  for (int i = 0; i < this->parents.size(); i++) {
-    if (this->parents[i] == node) {
-      this->parents.erase(this->parents.begin() + i);
-      node->removeNode(shared_from_this());
-    }
-  }
+  this->root = root;
+  record(op);
 }
 
-void Node::clear() {
-  for (const auto &node : this->parents)
-    node->removeNode(shared_from_this());
-
-  for (const auto &node : this->children)
-    node->removeParent(shared_from_this());
+bool Node::isPinned() const { return this->pinned; }
+void Node::setPinned(bool pinned) {
+  MapOp op{MapOp::SetPinned, this->id};
+  op.flag = pinned;
+  op.oldFlag = this->pinned;
 
-  this->parents.clear();
-  this->children.clear();
+  this->pinned = pinned;
+  record(op);
 }
 
-SDL_Surface *Node::renderMultilineSurface(const char *text, TTF_Font *font,
-                                          SDL_Color color) {
-  char *textCopy = strdup(text);
-  char *line = strtok(textCopy, "\n");
+bool Node::isCenteredText() const { return this->centeredText; }
+void Node::setCenteredText(bool centered) {
+  MapOp op{MapOp::SetCenteredText, this->id};
+  op.flag = centered;
+  op.oldFlag = this->centeredText;
 
-  int totalHeight = 0;
-  int maxWidth = 0;
-  char *lines[128];
-  int numLines = 0;
+  this->centeredText = centered;
+  record(op);
+}
 
-  while (line && numLines < 128) {
-    lines[numLines++] = strdup(line);
+const std::string &Node::getText() const { return this->text; }
 
-    int w, h;
-    TTF_SizeUTF8(font, line, &w, &h);
-    if (w > maxWidth)
-      maxWidth = w;
-    totalHeight += h;
+const std::vector<uint32_t> &Node::getParents() const { return this->parents; }
+const std::vector<uint32_t> &Node::getChildren() const {
+  return this->children;
+}
 
-    line = strtok(NULL, "\n");
-  }
+void Node::addNode(Node *node) {
+  this->children.push_back(node->id.index);
+  Map::curMap->index.updateEdge(this, node, this->x, this->y, node->x,
+                                node->y);
+}
 
-  SDL_Surface *final =
-      SDL_CreateRGBSurface(0, maxWidth, totalHeight, 32, 0x00FF0000, 0x0000FF00,
-                           0x000000FF, 0xFF000000);
+void Node::removeNode(Node *node) {
+  if (eraseIndex(this->children, node->id.index))
+    Map::curMap->index.removeEdge(this, node);
+}
 
-  int y = 0;
+void Node::toggleParent(Node *node) {
+  if (node == this)
+    return;
 
-  if (!final) {
-    fprintf(stderr, "Failed to create final surface: %s\n", SDL_GetError());
-    goto cleanup;
-  }
+  if (std::find(this->parents.begin(), this->parents.end(),
+                node->id.index) != this->parents.end())
+    removeParent(node);
+  else
+    addParent(node);
+}
 
-  for (int i = 0; i < numLines; ++i) {
-    SDL_Surface *lineSurf = TTF_RenderUTF8_Blended(font, lines[i], color);
-    if (!lineSurf) {
-      fprintf(stderr, "Render failed: %s\n", TTF_GetError());
-      continue;
-    }
+void Node::addParent(Node *node) {
+  if (node == this)
+    return;
 
-    SDL_Rect dest = {this->centeredText ? (final->w - lineSurf->w) / 2 : 0, y,
-                     lineSurf->w, lineSurf->h};
-    SDL_BlitSurface(lineSurf, NULL, final, &dest);
-    y += lineSurf->h;
+  if (std::find(this->parents.begin(), this->parents.end(),
+                node->id.index) != this->parents.end())
+    return;
 
-    if (lineSurf) SDL_FreeSurface(lineSurf);
+  if (!Map::curMap->order.addEdge(node->id.index, this->id.index)) {
+    std::cout << "Refusing edge: it would create a cycle\n";
+    return;
   }
 
-cleanup:
-  for (int i = 0; i < numLines; ++i)
-    free(lines[i]);
-  free(textCopy);
-
-  return final;
+  this->parents.push_back(node->id.index);
+  node->addNode(this);
+  record({MapOp::AddEdge, node->id, this->id});
 }
 
-void Node::updateTextTexture(SDL_Renderer *renderer) {
-  if (this->textSurface) SDL_FreeSurface(this->textSurface);
-  this->textSurface =
-      TTF_RenderText_Solid(this->font, this->text.c_str(), this->textColor);
-
-  if (!this->textSurface) {
-    std::cout << "TTF_RenderText_Solid failed: " << TTF_GetError() << '\n';
+void Node::removeParent(Node *node) {
+  if (!eraseIndex(this->parents, node->id.index))
     return;
-  }
-
-  int area = this->textSurface->w * this->textSurface->h;
-  int len = static_cast<int>(sqrt(area));
-
-  std::vector<std::string> words = {};
-
-  std::string curWord = "";
-  int width = 0;
-  for (int i = 0; i < text.length(); i++) {
-    char c = text[i];
 
-    if (c == ' ' && width > len) {
-      width = 0;
-      words.push_back(curWord);
-      curWord = "";
-      continue;
-    }
+  node->removeNode(this);
+  record({MapOp::RemoveEdge, node->id, this->id});
+}
 
-    curWord += c;
-    int tempWidth, tempHeight;
-    char chr[2] = {c, '\0'};
-    TTF_SizeText(font, chr, &tempWidth, &tempHeight);
-    width += tempWidth;
+void Node::clear() {
+  MapOp op{MapOp::Clear, this->id};
+  for (uint32_t index : this->parents)
+    op.parents.push_back(nodeAt(index)->id);
+  for (uint32_t index : this->children)
+    op.children.push_back(nodeAt(index)->id);
+  record(op);
+
+  for (uint32_t index : this->parents) {
+    Node *parent = nodeAt(index);
+    eraseIndex(parent->children, this->id.index);
+    Map::curMap->index.removeEdge(parent, this);
+  }
 
-    if (i + 1 == text.length())
-      words.push_back(curWord);
+  for (uint32_t index : this->children) {
+    Node *child = nodeAt(index);
+    eraseIndex(child->parents, this->id.index);
+    Map::curMap->index.removeEdge(this, child);
   }
 
-  std::string tempText = "";
+  this->parents.clear();
+  this->children.clear();
+}
 
-  for (int i = 0; i < words.size(); i++) {
-    std::string word = words[i];
-    tempText += word;
-    if (i + 1 != words.size())
-      tempText += '\n';
-  }
+std::shared_ptr<const TextLayout> Node::updateTextLayout() {
+  Profiler::Scope scope(Profiler::Phase::Text);
+  std::shared_ptr<const TextLayout> layout =
+      LabelCache::get(this->font, this->text);
+  this->layout = layout;
+  updateRadius(*layout);
+  return layout;
+}
 
-  if (this->textSurface) SDL_FreeSurface(this->textSurface);
-  this->textSurface =
-      renderMultilineSurface(tempText.c_str(), this->font, this->textColor);
+float Node::radiusFor(const TextLayout &layout) {
+  int w = layout.getWidth();
+  int h = layout.getHeight();
 
-  this->radius = static_cast<float>(
-                     std::sqrt(this->textSurface->w * this->textSurface->w +
-                               this->textSurface->h * this->textSurface->h)) /
-                     2 +
-                 10;
+  float radius = static_cast<float>(std::sqrt(w * w + h * h)) / 2 + 10;
+  return std::min(radius, 500.0f);
+}
 
-  if (!this->textSurface) {
-    std::cout << "TTF_RenderText_Solid failed: " << TTF_GetError() << '\n';
-    return;
-  }
+void Node::updateRadius(const TextLayout &layout) {
+  this->radius = radiusFor(layout);
+  updateIndex();
+}
 
-  if (this->textTexture) SDL_DestroyTexture(this->textTexture);
-  this->textTexture = SDL_CreateTextureFromSurface(renderer, this->textSurface);
+void Node::setText(std::string text) {
+  std::string old = std::move(this->text);
+  this->text = text;
+  recordText(std::move(old));
+  updateTextLayout();
+}
 
-  if (!this->textTexture) {
-    std::cout << "SDL_CreateTextureFromSurface failed: " << SDL_GetError()
-              << '\n';
-    return;
-  }
+void Node::recordText(std::string oldText) const {
+  // Every label edit comes through here.
+  Map::curMap->search.set(this->id.index, this->text);
+
+  MapOp op{MapOp::SetText, this->id};
+  op.text = this->text;
+  op.oldText = std::move(oldText);
+  record(op);
 }
 
-void Node::setText(SDL_Renderer *renderer, std::string text) {
+void Node::restoreText(const std::string &text, float radius) {
   this->text = text;
-  updateTextTexture(renderer);
+  this->radius = radius;
+  this->layout.reset();
+  updateIndex();
 }
 
-void Node::appendText(SDL_Renderer *renderer, char text[32]) {
+void Node::appendText(char text[32]) {
+  std::shared_ptr<const TextLayout> old = this->layout.lock();
+
+  size_t pos = this->text.size();
   this->text += text;
-  updateTextTexture(renderer);
+  recordText(this->text.substr(0, pos));
+
+  if (!old) {
+    updateTextLayout();
+    return;
+  }
+
+  // Labels are shared, so edit a private copy and file it under the new
+  // text.
+  auto layout = std::make_shared<TextLayout>(*old);
+  layout->insert(FontMetrics::get(this->font), this->text, pos,
+                 this->text.size() - pos);
+  old = LabelCache::put(this->font, this->text, std::move(layout));
+  this->layout = old;
+  updateRadius(*old);
 }
 
-void Node::popChar(SDL_Renderer *renderer) {
+void Node::popChar() {
   if (this->text.empty())
     return;
 
-  this->text.pop_back();
-  updateTextTexture(renderer);
-}
+  std::shared_ptr<const TextLayout> old = this->layout.lock();
 
-void Node::tick(float dt) {}
+  // Drop a whole UTF-8 sequence, not just its last byte.
+  size_t pos = this->text.size() - 1;
+  while (pos > 0 && (static_cast<unsigned char>(this->text[pos]) & 0xC0) ==
+                        0x80)
+    pos--;
 
-void Node::render(SDL_Renderer *renderer) {
-  if (this->radius < 0) this->radius = 50;
-  if (this->radius > 500) this->radius = 500;
+  std::string removed = this->text.substr(pos);
+  this->text.erase(pos);
+  recordText(this->text + removed);
 
-  if (Map::curMap->currentNode == shared_from_this()) {
-    filledCircleRGBA(renderer, this->x + Map::curMap->dx,
-                     this->y + Map::curMap->dy, this->radius + 10, 0, 255, 0,
-                     100);
+  if (!old) {
+    updateTextLayout();
+    return;
   }
 
-  filledCircleRGBA(renderer, this->x + Map::curMap->dx,
-                   this->y + Map::curMap->dy, this->radius, this->bgColor.r,
-                   this->bgColor.g, this->bgColor.b, 255);
+  auto layout = std::make_shared<TextLayout>(*old);
+  layout->erase(FontMetrics::get(this->font), this->text, pos, removed);
+  old = LabelCache::put(this->font, this->text, std::move(layout));
+  this->layout = old;
+  updateRadius(*old);
+}
 
-  aacircleRGBA(renderer, this->x + Map::curMap->dx, this->y + Map::curMap->dy,
-               this->radius, 0, 0, 0, 255);
+void Node::tick(float dt) {
+  float fx = this->fx;
+  float fy = this->fy;
+  this->fx = 0;
+  this->fy = 0;
 
-  if (this->text.length() > 0) {
-    if (this->textSurface == nullptr || updateText) {
-      this->updateTextTexture(renderer);
-      this->updateText = 0;
-    } else {
-      SDL_Rect rect = {static_cast<int>(this->x + Map::curMap->dx -
-                                        this->textSurface->w / 2.0),
-                       static_cast<int>(this->y + Map::curMap->dy -
-                                        this->textSurface->h / 2.0),
-                       this->textSurface->w, this->textSurface->h};
-      SDL_RenderCopy(renderer, this->textTexture, nullptr, &rect);
-    }
+  if (this->pinned) {
+    this->vx = 0;
+    this->vy = 0;
+    return;
   }
-}
 
-void rotate(float &x, float &y, float angle) {
-  float theta = static_cast<float>(std::atan(y / x) + (x < 0 ? M_PI : 0));
-  theta += angle;
+  float friction = std::exp(-layoutFriction * dt);
+  this->vx = (this->vx + fx * dt) * friction;
+  this->vy = (this->vy + fy * dt) * friction;
 
-  float d = static_cast<float>(sqrt(x * x + y * y));
+  float speed = std::sqrt(this->vx * this->vx + this->vy * this->vy);
+  if (speed > layoutMaxSpeed) {
+    this->vx *= layoutMaxSpeed / speed;
+    this->vy *= layoutMaxSpeed / speed;
+  }
 
-  x = d * cos(theta);
-  y = d * sin(theta);
+  this->x += this->vx * dt;
+  this->y += this->vy * dt;
 }
 
-void Node::renderLines(SDL_Renderer *renderer, float zoom) {
-  SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-  for (const auto &node : this->children) {
-    SDL_RenderDrawLine(
-        renderer, (this->x + Map::curMap->dx) * zoom, (this->y + Map::curMap->dy) * zoom,
-        (node->getX() + Map::curMap->dx) * zoom, (node->getY() + Map::curMap->dy) * zoom);
+void Node::render(SDL_Renderer *renderer, CircleBatch &circles,
+                  bool withText) {
+  if (this->radius < 0) this->radius = 50;
+  if (this->radius > 500) this->radius = 500;
 
-    float dx = node->getX() - this->x;
-    float dy = node->getY() - this->y;
+  float x = this->x + Map::curMap->dx;
+  float y = this->y + Map::curMap->dy;
 
-    float d = sqrt(dx * dx + dy * dy);
+  if (Map::curMap->currentNode == this->id)
+    circles.addDisc(x, y, this->radius + 10, {0, 255, 0, 100});
+  else if (Map::curMap->isHighlighted(this->id))
+    circles.addDisc(x, y, this->radius + 10, {255, 190, 0, 140});
 
-    float angle = static_cast<float>(std::atan(dy / dx) + (dx < 0 ? M_PI : 0));
-    float cx = d - node->getRadius();
-    float cy = 0;
+  this->renderShape(circles, Map::curMap->dx, Map::curMap->dy);
 
-    float x1 = d - node->getRadius() - 20;
-    float x2 = x1;
+  if (withText && this->text.length() > 0) {
+    std::shared_ptr<const TextLayout> layout = this->layout.lock();
+    if (!layout || updateText) {
+      layout = this->updateTextLayout();
+      this->updateText = 0;
+    }
 
-    float y1 = -10;
-    float y2 = 10;
+    GlyphAtlas *atlas = GlyphAtlas::get(renderer, this->font);
+    float lineY = this->y + Map::curMap->dy - layout->getHeight() / 2.0f;
+    for (const auto &line : layout->getLines()) {
+      float lineX = this->x + Map::curMap->dx -
+                    (this->centeredText ? line.width
+                                        : layout->getWidth()) /
+                        2.0f;
+      atlas->queueText(this->text, line.begin, line.end, lineX, lineY,
+                       this->textColor);
+      lineY += atlas->getLineHeight();
+    }
+  }
+}
 
-    rotate(x1, y1, angle);
-    rotate(x2, y2, angle);
-    rotate(cx, cy, angle);
+void Node::renderShape(CircleBatch &circles, float dx, float dy) const {
+  float x = this->x + dx;
+  float y = this->y + dy;
 
-    x1 += this->x;
-    x2 += this->x;
+  circles.addDisc(x, y, this->radius,
+                  {this->bgColor.r, this->bgColor.g, this->bgColor.b, 255});
+  circles.addRing(x, y, this->radius, 1, {0, 0, 0, 255});
+  if (this->pinned)
+    circles.addRing(x, y, this->radius - 4, 1, {0, 0, 0, 255});
+}
 
-    y1 += this->y;
-    y2 += this->y;
+void Node::setFont(TTF_Font* font) {
+  this->font = font;
+  this->layout.reset();
+}
 
-    cx += this->x;
-    cy += this->y;
+void Node::updateIndex() {
+  Map::curMap->index.update(this, this->x, this->y, this->radius);
+}
+
+void Node::reindex() {
+  updateIndex();
 
-    SDL_RenderDrawLine(renderer, (cx + Map::curMap->dx) * zoom, (cy + Map::curMap->dy ) * zoom,
-                       (x1 + Map::curMap->dx) * zoom, (y1 + Map::curMap->dy) * zoom);
-    SDL_RenderDrawLine(renderer, (cx + Map::curMap->dx) * zoom, (cy + Map::curMap->dy) * zoom,
-                       (x2 + Map::curMap->dx) * zoom, (y2 + Map::curMap->dy) * zoom);
+  for (uint32_t index : this->children) {
+    Node *node = nodeAt(index);
+    Map::curMap->index.updateEdge(this, node, this->x, this->y, node->x,
+                                  node->y);
   }
-}
 
-void Node::setFont(TTF_Font* font) {
-  this->font = font;
+  for (uint32_t index : this->parents) {
+    Node *node = nodeAt(index);
+    Map::curMap->index.updateEdge(node, this, node->x, node->y, this->x,
+                                  this->y);
+  }
 }
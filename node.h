@@ -1,31 +1,44 @@
 #ifndef NODE_H
 #define NODE_H
 
-#include <boost/serialization/access.hpp>
-#include <boost/serialization/assume_abstract.hpp>
-#include <boost/serialization/export.hpp>
-#include <boost/serialization/nvp.hpp>
-#include <boost/serialization/shared_ptr.hpp>
-#include <boost/serialization/string.hpp>
-#include <boost/serialization/vector.hpp>
-#include <boost/serialization/weak_ptr.hpp>
-#include <memory>
-
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
+#include "circlebatch.h"
+#include "textlayout.h"
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
-class Node : public std::enable_shared_from_this<Node> {
+// Stable handle to a node in Map::nodes. The generation makes handles to
+// deleted nodes resolve to nullptr even after their slot is reused.
+struct NodeId {
+  static constexpr uint32_t invalidIndex = UINT32_MAX;
+
+  uint32_t index = invalidIndex;
+  uint32_t generation = 0;
+
+  bool isValid() const { return index != invalidIndex; }
+
+  bool operator==(const NodeId &other) const {
+    return index == other.index && generation == other.generation;
+  }
+  bool operator!=(const NodeId &other) const { return !(*this == other); }
+};
+
+class Node {
 public:
-  static std::shared_ptr<Node> create(float x, float y, TTF_Font *font);
+  static Node *create(float x, float y, TTF_Font *font);
 
   void destruct();
 
+  NodeId getId() const;
+
   SDL_Color getBgColor() const;
   SDL_Color getTxtColor() const;
 
   void setBgColor(int r, int g, int b);
+  void setTxtColor(SDL_Color color);
 
   float getX() const;
   float getY() const;
@@ -35,35 +48,80 @@ public:
 
   void setXRec(float x);
   void setYRec(float y);
+  void setPosRec(float x, float y);
 
   float getRadius() const;
+  unsigned int getDrawOrder() const;
+
+  bool isRoot() const;
+  void setRoot(bool root);
+
+  // Pinned nodes are left where they are by auto-layout.
+  bool isPinned() const;
+  void setPinned(bool pinned);
+
+  bool isCenteredText() const;
+  void setCenteredText(bool centered);
+
+  const std::string &getText() const;
+
+  const std::vector<uint32_t> &getParents() const;
+  const std::vector<uint32_t> &getChildren() const;
 
-  void addNode(std::shared_ptr<Node> node);
-  void removeNode(std::shared_ptr<Node> node);
   void clear();
 
-  void toggleParent(std::shared_ptr<Node> node);
-  void addParent(std::shared_ptr<Node> node);
-  void removeParent(std::shared_ptr<Node> node);
+  void toggleParent(Node *node);
+  void addParent(Node *node);
+  void removeParent(Node *node);
 
-  void setText(SDL_Renderer *renderer, std::string text);
-  void appendText(SDL_Renderer *renderer, char text[32]);
-  void popChar(SDL_Renderer *renderer);
+  void setText(std::string text);
+  // Sets text and radius as saved, leaving layout for the first render.
+  void restoreText(const std::string &text, float radius);
+  void appendText(char text[32]);
+  void popChar();
 
+  // Integrates the force auto-layout accumulated for this node.
   void tick(float dt);
-  void render(SDL_Renderer *renderer);
-  void renderLines(SDL_Renderer *renderer, float zoom);
+  // Labels are left out when withText is false, for low zoom.
+  // Body, outline and selection halo go to circles, which the map draws
+  // in one call once every visible node has been added.
+  void render(SDL_Renderer *renderer, CircleBatch &circles, bool withText);
+  // Body, outline and pinned ring offset by dx, dy, without halos; shared
+  // by render and the PNG export.
+  void renderShape(CircleBatch &circles, float dx, float dy) const;
 
   void setFont(TTF_Font* font);
+  void reindex();
 
 private:
-  Node(float x, float y, TTF_Font *font);
-  void updateTextTexture(SDL_Renderer *renderer);
-  SDL_Surface *renderMultilineSurface(const char *text, TTF_Font *font,
-                                      SDL_Color color);
+  friend class NodeStore;
+  friend class MindFile;
+  friend class Importer;
+  friend class Map;
+  friend class ForceLayout;
+  friend class HierarchyLayout;
 
-  std::vector<std::shared_ptr<Node>> parents;
-  std::vector<std::shared_ptr<Node>> children;
+  Node(float x, float y, TTF_Font *font);
+  void addNode(Node *node);
+  void removeNode(Node *node);
+  std::shared_ptr<const TextLayout> updateTextLayout();
+  // Smallest circle around a label, capped for very long ones.
+  static float radiusFor(const TextLayout &layout);
+  void updateRadius(const TextLayout &layout);
+  void updateIndex();
+  void translateRec(float dx, float dy);
+  void recordMove(float oldX, float oldY) const;
+  void recordText(std::string oldText) const;
+
+  NodeId id;
+
+  // Adjacency as slot indices into Map::nodes. Edges are always removed
+  // before either endpoint is destroyed, so these never go stale.
+  std::vector<uint32_t> parents;
+  std::vector<uint32_t> children;
+
+  bool root = 0;
+  bool pinned = 0;
 
   bool updateText = 0;
 
@@ -72,38 +130,26 @@ private:
 
   float radius = 0;
 
+  // Auto-layout state.
+  float vx = 0;
+  float vy = 0;
+  float fx = 0;
+  float fy = 0;
+
+  unsigned int drawOrder = nextDrawOrder++;
+  inline static unsigned int nextDrawOrder = 0;
+
   std::string text;
 
   SDL_Color textColor;
   SDL_Color bgColor;
 
-  SDL_Surface *textSurface = nullptr;
-  SDL_Texture *textTexture = nullptr;
+  // Owned by LabelCache; expires when the label is evicted.
+  std::weak_ptr<const TextLayout> layout;
+
   TTF_Font *font;
 
   bool centeredText = 1;
-
-  friend class boost::serialization::access;
-  template <class Archive>
-  void serialize(Archive &ar, const unsigned int version) {
-    ar &boost::serialization::make_nvp("x", x);
-    ar &boost::serialization::make_nvp("y", y);
-    ar &boost::serialization::make_nvp("radius", radius);
-    ar &boost::serialization::make_nvp("text", text);
-    ar &boost::serialization::make_nvp("textColor_r", textColor.r);
-    ar &boost::serialization::make_nvp("textColor_g", textColor.g);
-    ar &boost::serialization::make_nvp("textColor_b", textColor.b);
-    ar &boost::serialization::make_nvp("textColor_a", textColor.a);
-    ar &boost::serialization::make_nvp("bgColor_r", bgColor.r);
-    ar &boost::serialization::make_nvp("bgColor_g", bgColor.g);
-    ar &boost::serialization::make_nvp("bgColor_b", bgColor.b);
-    ar &boost::serialization::make_nvp("bgColor_a", bgColor.a);
-    ar &boost::serialization::make_nvp("centeredText", centeredText);
-    ar &boost::serialization::make_nvp("parents", parents);
-    ar &boost::serialization::make_nvp("children", children);
-  }
-
-  Node() : x(0), y(0), font(nullptr) {}
 };
 
 #endif
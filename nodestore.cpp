@@ -0,0 +1,100 @@
+#include "nodestore.h"
+#include <new>
+
+NodeStore::~NodeStore() { this->clear(); }
+
+NodeStore::Slot &NodeStore::slot(uint32_t index) const {
+  return this->chunks[index / chunkSize][index % chunkSize];
+}
+
+Node *NodeStore::place(uint32_t index, float x, float y, TTF_Font *font) {
+  Slot &s = this->slot(index);
+  s.livePos = static_cast<uint32_t>(this->live.size());
+  this->live.push_back(index);
+
+  Node *node = new (s.storage) Node(x, y, font);
+  node->id = {index, s.generation};
+  return node;
+}
+
+Node *NodeStore::create(float x, float y, TTF_Font *font) {
+  // createAt can take slots that are still on the free list; skip those.
+  while (!this->freeList.empty() &&
+         this->slot(this->freeList.back()).livePos != freeSlot)
+    this->freeList.pop_back();
+
+  if (this->freeList.empty()) {
+    uint32_t base = static_cast<uint32_t>(this->chunks.size()) * chunkSize;
+    this->chunks.emplace_back(new Slot[chunkSize]);
+    for (uint32_t i = chunkSize; i > 0; i--)
+      this->freeList.push_back(base + i - 1);
+  }
+
+  uint32_t index = this->freeList.back();
+  this->freeList.pop_back();
+
+  return this->place(index, x, y, font);
+}
+
+Node *NodeStore::createAt(NodeId id, float x, float y, TTF_Font *font) {
+  while (id.index / chunkSize >= this->chunks.size()) {
+    uint32_t base = static_cast<uint32_t>(this->chunks.size()) * chunkSize;
+    this->chunks.emplace_back(new Slot[chunkSize]);
+    for (uint32_t i = chunkSize; i > 0; i--)
+      this->freeList.push_back(base + i - 1);
+  }
+
+  Slot &s = this->slot(id.index);
+  if (s.livePos != freeSlot)
+    return nullptr;
+
+  s.generation = id.generation;
+  return this->place(id.index, x, y, font);
+}
+
+void NodeStore::destroy(Node *node) {
+  uint32_t index = node->id.index;
+  Slot &s = this->slot(index);
+
+  uint32_t moved = this->live.back();
+  this->live[s.livePos] = moved;
+  this->slot(moved).livePos = s.livePos;
+  this->live.pop_back();
+
+  node->~Node();
+  s.livePos = freeSlot;
+  s.generation++;
+  this->freeList.push_back(index);
+}
+
+void NodeStore::clear() {
+  for (uint32_t index : this->live) {
+    Slot &s = this->slot(index);
+    reinterpret_cast<Node *>(s.storage)->~Node();
+    s.livePos = freeSlot;
+    s.generation++;
+  }
+  this->live.clear();
+
+  this->freeList.clear();
+  for (uint32_t i = static_cast<uint32_t>(this->chunks.size()) * chunkSize;
+       i > 0; i--)
+    this->freeList.push_back(i - 1);
+}
+
+Node *NodeStore::get(NodeId id) const {
+  if (id.index / chunkSize >= this->chunks.size())
+    return nullptr;
+
+  Slot &s = this->slot(id.index);
+  if (s.livePos == freeSlot || s.generation != id.generation)
+    return nullptr;
+
+  return reinterpret_cast<Node *>(s.storage);
+}
+
+Node *NodeStore::at(uint32_t index) const {
+  return reinterpret_cast<Node *>(this->slot(index).storage);
+}
+
+size_t NodeStore::size() const { return this->live.size(); }
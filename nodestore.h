@@ -0,0 +1,53 @@
+#ifndef NODESTORE_H
+#define NODESTORE_H
+
+#include "node.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Pool allocator for nodes. Nodes live in fixed-size chunks so their
+// addresses never move, slots are recycled through a free list, and every
+// slot carries a generation that is bumped on destroy so stale NodeIds
+// resolve to nullptr instead of a recycled node.
+class NodeStore {
+public:
+  NodeStore() = default;
+  NodeStore(const NodeStore &) = delete;
+  NodeStore &operator=(const NodeStore &) = delete;
+  ~NodeStore();
+
+  Node *create(float x, float y, TTF_Font *font);
+  Node *createAt(NodeId id, float x, float y, TTF_Font *font);
+  void destroy(Node *node);
+  void clear();
+
+  Node *get(NodeId id) const;
+  Node *at(uint32_t index) const;
+
+  size_t size() const;
+
+  template <class F> void forEach(F f) const {
+    for (uint32_t index : this->live)
+      f(this->at(index));
+  }
+
+private:
+  struct Slot {
+    alignas(Node) unsigned char storage[sizeof(Node)];
+    uint32_t generation = 0;
+    uint32_t livePos = freeSlot;
+  };
+
+  static constexpr uint32_t chunkSize = 1024;
+  static constexpr uint32_t freeSlot = UINT32_MAX;
+
+  Slot &slot(uint32_t index) const;
+  Node *place(uint32_t index, float x, float y, TTF_Font *font);
+
+  std::vector<std::unique_ptr<Slot[]>> chunks;
+  std::vector<uint32_t> freeList;
+  std::vector<uint32_t> live;
+};
+
+#endif
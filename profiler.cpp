@@ -0,0 +1,136 @@
+#include "profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+using Clock = std::chrono::steady_clock;
+
+static const char *phaseNames[] = {"frame", "events", "layout",
+                                   "edges", "nodes",  "text",
+                                   "glyphs", "hud",   "present"};
+
+Profiler::Scope::Scope(Phase phase)
+    : phase(phase), active(Profiler::enabled || Profiler::traceFrames > 0) {
+  if (this->active)
+    this->start = Clock::now();
+}
+
+Profiler::Scope::~Scope() {
+  if (this->active)
+    Profiler::add(this->phase, this->start, Clock::now());
+}
+
+void Profiler::setEnabled(bool enabled) {
+  Profiler::enabled = enabled;
+  if (!enabled) {
+    window.clear();
+    next = 0;
+  }
+}
+
+bool Profiler::isEnabled() { return enabled; }
+
+void Profiler::add(Phase phase, Clock::time_point start,
+                   Clock::time_point end) {
+  current[static_cast<size_t>(phase)] +=
+      std::chrono::duration<double, std::milli>(end - start).count();
+
+  if (traceFrames > 0) {
+    using Micros = std::chrono::duration<double, std::micro>;
+    events.push_back({phase, Micros(start - traceStart).count(),
+                      Micros(end - start).count()});
+  }
+}
+
+void Profiler::beginFrame() { frameStart = Clock::now(); }
+
+void Profiler::endFrame() {
+  if (enabled || traceFrames > 0)
+    add(Phase::Frame, frameStart, Clock::now());
+
+  if (enabled) {
+    std::array<float, phaseCount> frame;
+    for (size_t i = 0; i < phaseCount; i++)
+      frame[i] = static_cast<float>(current[i]);
+
+    if (window.size() < windowFrames)
+      window.push_back(frame);
+    else
+      window[next] = frame;
+    next = (next + 1) % windowFrames;
+  }
+  current.fill(0);
+
+  if (traceFrames > 0 && --traceFrames == 0)
+    writeTrace();
+}
+
+double Profiler::percentile(Phase phase, double p) {
+  if (window.empty())
+    return 0;
+
+  std::vector<float> samples;
+  samples.reserve(window.size());
+  for (const auto &frame : window)
+    samples.push_back(frame[static_cast<size_t>(phase)]);
+
+  size_t rank = std::min(samples.size() - 1,
+                         static_cast<size_t>(p * (samples.size() - 1) + 0.5));
+  std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+  return samples[rank];
+}
+
+const char *Profiler::name(Phase phase) {
+  return phaseNames[static_cast<size_t>(phase)];
+}
+
+std::vector<std::string> Profiler::summary() {
+  std::vector<std::string> lines;
+  lines.push_back("phase      p50 ms   p99 ms");
+  char line[64];
+  for (size_t i = 0; i < phaseCount; i++) {
+    Phase phase = static_cast<Phase>(i);
+    std::snprintf(line, sizeof(line), "%-8s %8.2f %8.2f", name(phase),
+                  percentile(phase, 0.5), percentile(phase, 0.99));
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+void Profiler::startTrace(const std::string &path, int frames) {
+  if (frames <= 0)
+    return;
+
+  tracePath = path;
+  traceFrames = frames;
+  events.clear();
+  traceStart = Clock::now();
+  std::cout << "Tracing " << frames << " frames to " << path << '\n';
+}
+
+bool Profiler::isTracing() { return traceFrames > 0; }
+
+void Profiler::writeTrace() {
+  std::ofstream out(tracePath);
+  if (!out) {
+    std::cout << "Failed to open " << tracePath << '\n';
+    events.clear();
+    return;
+  }
+
+  out << "{\"traceEvents\":[\n";
+  for (size_t i = 0; i < events.size(); i++) {
+    const Event &event = events[i];
+    out << "{\"name\":\"" << name(event.phase)
+        << "\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":"
+        << event.start << ",\"dur\":" << event.duration << '}'
+        << (i + 1 < events.size() ? ",\n" : "\n");
+  }
+  out << "],\"displayTimeUnit\":\"ms\"}\n";
+
+  std::cout << "Wrote " << events.size() << " trace events to " << tracePath
+            << '\n';
+  events.clear();
+  events.shrink_to_fit();
+}
@@ -0,0 +1,92 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Per-phase frame timings. Scopes add their elapsed time to the current
+// frame's phase and endFrame() closes the frame, keeping a rolling window
+// for percentiles. While a trace is being captured every scope is also
+// kept as a Chrome trace event ("X" phase, microseconds) and written out
+// once the requested number of frames has passed; load the file in
+// chrome://tracing or Perfetto.
+//
+// Phases nest (Text runs inside Nodes), so their times are inclusive. When
+// neither the overlay nor a trace wants samples, scopes cost one branch.
+class Profiler {
+public:
+  enum class Phase {
+    Frame,
+    Events,
+    Layout,
+    Edges,
+    Nodes,
+    Text,
+    Glyphs,
+    Hud,
+    Present,
+    Count
+  };
+
+  class Scope {
+  public:
+    explicit Scope(Phase phase);
+    ~Scope();
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    Phase phase;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+  };
+
+  static void setEnabled(bool enabled);
+  static bool isEnabled();
+
+  // Bracket the drawing of a frame. Scopes hit between frames, like event
+  // handling, count towards the next one.
+  static void beginFrame();
+  static void endFrame();
+
+  // Milliseconds at percentile p (0..1) of the window, per phase.
+  static double percentile(Phase phase, double p);
+  static const char *name(Phase phase);
+  // One line per phase, "name p50 p99", for the overlay.
+  static std::vector<std::string> summary();
+
+  // Records the next `frames` frames and writes them to path.
+  static void startTrace(const std::string &path, int frames);
+  static bool isTracing();
+
+private:
+  static constexpr size_t phaseCount = static_cast<size_t>(Phase::Count);
+  static constexpr size_t windowFrames = 240;
+
+  struct Event {
+    Phase phase;
+    double start;
+    double duration;
+  };
+
+  static void add(Phase phase, std::chrono::steady_clock::time_point start,
+                  std::chrono::steady_clock::time_point end);
+  static void writeTrace();
+
+  inline static bool enabled = 0;
+
+  inline static std::array<double, phaseCount> current{};
+  inline static std::chrono::steady_clock::time_point frameStart;
+  inline static std::vector<std::array<float, phaseCount>> window;
+  inline static size_t next = 0;
+
+  inline static std::string tracePath;
+  inline static int traceFrames = 0;
+  inline static std::vector<Event> events;
+  inline static std::chrono::steady_clock::time_point traceStart;
+};
+
+#endif
@@ -0,0 +1,182 @@
+#include "searchindex.h"
+#include "nodestore.h"
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+static uint32_t packTrigram(const std::string &text, size_t i) {
+  return (uint32_t(static_cast<unsigned char>(text[i])) << 16) |
+         (uint32_t(static_cast<unsigned char>(text[i + 1])) << 8) |
+         uint32_t(static_cast<unsigned char>(text[i + 2]));
+}
+
+std::string SearchIndex::fold(const std::string &text) {
+  std::string folded = text;
+  // UTF-8 sequences never contain ASCII bytes, so they pass through intact.
+  for (char &c : folded)
+    if (c >= 'A' && c <= 'Z')
+      c = static_cast<char>(c - 'A' + 'a');
+  return folded;
+}
+
+void SearchIndex::trigrams(const std::string &folded,
+                           std::vector<uint32_t> &out) {
+  out.clear();
+  for (size_t i = 0; i + 3 <= folded.size(); i++)
+    out.push_back(packTrigram(folded, i));
+  std::sort(out.begin(), out.end());
+  out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+void SearchIndex::link(uint32_t trigram, uint32_t index) {
+  std::vector<uint32_t> &list = this->postings[trigram];
+  list.insert(std::lower_bound(list.begin(), list.end(), index), index);
+}
+
+void SearchIndex::unlink(uint32_t trigram, uint32_t index) {
+  auto it = this->postings.find(trigram);
+  if (it == this->postings.end())
+    return;
+
+  std::vector<uint32_t> &list = it->second;
+  auto at = std::lower_bound(list.begin(), list.end(), index);
+  if (at != list.end() && *at == index)
+    list.erase(at);
+  if (list.empty())
+    this->postings.erase(it);
+}
+
+void SearchIndex::set(uint32_t index, const std::string &text) {
+  if (index >= this->texts.size()) {
+    this->texts.resize(index + 1);
+    this->present.resize(index + 1, false);
+  }
+
+  std::string folded = fold(text);
+  std::vector<uint32_t> before, after;
+  if (this->present[index]) {
+    if (folded == this->texts[index])
+      return;
+    trigrams(this->texts[index], before);
+  } else {
+    this->present[index] = true;
+    this->count++;
+  }
+  trigrams(folded, after);
+
+  std::vector<uint32_t> changed;
+  std::set_difference(before.begin(), before.end(), after.begin(),
+                      after.end(), std::back_inserter(changed));
+  for (uint32_t trigram : changed)
+    this->unlink(trigram, index);
+
+  changed.clear();
+  std::set_difference(after.begin(), after.end(), before.begin(),
+                      before.end(), std::back_inserter(changed));
+  for (uint32_t trigram : changed)
+    this->link(trigram, index);
+
+  this->texts[index] = std::move(folded);
+}
+
+void SearchIndex::remove(uint32_t index) {
+  if (index >= this->present.size() || !this->present[index])
+    return;
+
+  std::vector<uint32_t> before;
+  trigrams(this->texts[index], before);
+  for (uint32_t trigram : before)
+    this->unlink(trigram, index);
+
+  this->texts[index].clear();
+  this->texts[index].shrink_to_fit();
+  this->present[index] = false;
+  this->count--;
+}
+
+void SearchIndex::clear() {
+  this->texts.clear();
+  this->present.clear();
+  this->postings.clear();
+  this->count = 0;
+}
+
+void SearchIndex::build(const NodeStore &nodes) {
+  this->clear();
+
+  // Walking slots in ascending order appends to each list in order, so no
+  // list needs sorting or inserting into.
+  std::vector<Node *> sorted;
+  sorted.reserve(nodes.size());
+  nodes.forEach([&](Node *node) { sorted.push_back(node); });
+  std::sort(sorted.begin(), sorted.end(), [](const Node *a, const Node *b) {
+    return a->getId().index < b->getId().index;
+  });
+
+  if (!sorted.empty()) {
+    this->texts.resize(sorted.back()->getId().index + 1);
+    this->present.resize(this->texts.size(), false);
+  }
+
+  std::vector<uint32_t> found;
+  for (Node *node : sorted) {
+    uint32_t index = node->getId().index;
+    std::string folded = fold(node->getText());
+    trigrams(folded, found);
+    for (uint32_t trigram : found)
+      this->postings[trigram].push_back(index);
+
+    this->texts[index] = std::move(folded);
+    this->present[index] = true;
+    this->count++;
+  }
+}
+
+void SearchIndex::query(const std::string &query,
+                        std::vector<uint32_t> &out) const {
+  out.clear();
+  if (query.empty())
+    return;
+
+  std::string folded = fold(query);
+
+  if (folded.size() < 3) {
+    for (uint32_t index = 0; index < this->texts.size(); index++)
+      if (this->present[index] &&
+          this->texts[index].find(folded) != std::string::npos)
+        out.push_back(index);
+    return;
+  }
+
+  std::vector<uint32_t> needed;
+  trigrams(folded, needed);
+
+  std::vector<const std::vector<uint32_t> *> lists;
+  for (uint32_t trigram : needed) {
+    auto it = this->postings.find(trigram);
+    if (it == this->postings.end())
+      return;
+    lists.push_back(&it->second);
+  }
+  std::sort(lists.begin(), lists.end(),
+            [](const std::vector<uint32_t> *a, const std::vector<uint32_t> *b) {
+              return a->size() < b->size();
+            });
+
+  std::vector<uint32_t> candidates = *lists[0];
+  std::vector<uint32_t> next;
+  for (size_t i = 1; i < lists.size() && !candidates.empty(); i++) {
+    next.clear();
+    std::set_intersection(candidates.begin(), candidates.end(),
+                          lists[i]->begin(), lists[i]->end(),
+                          std::back_inserter(next));
+    std::swap(candidates, next);
+  }
+
+  // Sharing every trigram doesn't make the query a substring; check.
+  for (uint32_t index : candidates)
+    if (this->texts[index].find(folded) != std::string::npos)
+      out.push_back(index);
+}
+
+size_t SearchIndex::size() const { return this->count; }
@@ -0,0 +1,51 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class NodeStore;
+
+// Trigram index over node labels, keyed by slot index into Map::nodes like
+// the adjacency lists. Each trigram of a label, ASCII case folded, maps to
+// the sorted slots whose labels contain it; a substring query intersects the
+// lists for its own trigrams, smallest first, and checks the survivors
+// against the folded labels kept here. Queries under three bytes scan the
+// labels directly.
+//
+// Edits go through set, which only touches the trigrams that changed, so
+// typing into a label costs a few list updates per keystroke.
+class SearchIndex {
+public:
+  void set(uint32_t index, const std::string &text);
+  void remove(uint32_t index);
+  void clear();
+  // Replaces the whole index with the labels in nodes.
+  void build(const NodeStore &nodes);
+
+  // Slots whose label contains query, ignoring ASCII case, in ascending
+  // order.
+  void query(const std::string &query, std::vector<uint32_t> &out) const;
+
+  size_t size() const;
+
+private:
+  static std::string fold(const std::string &text);
+  // Distinct trigrams of folded text, sorted.
+  static void trigrams(const std::string &folded, std::vector<uint32_t> &out);
+
+  void link(uint32_t trigram, uint32_t index);
+  void unlink(uint32_t trigram, uint32_t index);
+
+  // Folded label per slot; present marks the slots that are indexed.
+  std::vector<std::string> texts;
+  std::vector<bool> present;
+  size_t count = 0;
+
+  std::unordered_map<uint32_t, std::vector<uint32_t>> postings;
+};
+
+#endif
@@ -0,0 +1,357 @@
+#include "spatialindex.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+int SpatialIndex::cellCoord(float v, float size) {
+  return static_cast<int>(std::floor(v / size));
+}
+
+uint64_t SpatialIndex::cellKey(int cx, int cy) {
+  return (uint64_t(uint32_t(cx)) << 32) | uint32_t(cy);
+}
+
+SpatialIndex::Item *SpatialIndex::findInCell(Node *node, uint64_t cell) {
+  auto it = this->cells.find(cell);
+  if (it == this->cells.end())
+    return nullptr;
+
+  for (Item &item : it->second)
+    if (item.node == node)
+      return &item;
+
+  return nullptr;
+}
+
+void SpatialIndex::removeFromCell(Node *node, uint64_t cell) {
+  auto it = this->cells.find(cell);
+  if (it == this->cells.end())
+    return;
+
+  std::vector<Item> &bucket = it->second;
+  for (size_t i = 0; i < bucket.size(); i++) {
+    if (bucket[i].node == node) {
+      bucket[i] = bucket.back();
+      bucket.pop_back();
+      break;
+    }
+  }
+
+  if (bucket.empty())
+    this->cells.erase(it);
+}
+
+void SpatialIndex::insert(Node *node, float x, float y, float radius) {
+  this->update(node, x, y, radius);
+}
+
+void SpatialIndex::update(Node *node, float x, float y, float radius) {
+  uint64_t cell = cellKey(cellCoord(x), cellCoord(y));
+
+  if (radius > this->maxRadius)
+    this->maxRadius = radius;
+
+  auto it = this->entries.find(node);
+  if (it != this->entries.end()) {
+    if (it->second == cell) {
+      if (Item *item = this->findInCell(node, cell)) {
+        *item = {node, x, y, radius};
+        return;
+      }
+    }
+    this->removeFromCell(node, it->second);
+    it->second = cell;
+  } else {
+    this->entries[node] = cell;
+  }
+
+  this->cells[cell].push_back({node, x, y, radius});
+}
+
+void SpatialIndex::remove(Node *node) {
+  auto it = this->entries.find(node);
+  if (it == this->entries.end())
+    return;
+
+  this->removeFromCell(node, it->second);
+  this->entries.erase(it);
+}
+
+void SpatialIndex::linkEdge(Edge *edge) {
+  // Imported graphs can have thousands of edges crossing the whole map; on
+  // the finest level each would need a bucket entry per cell it crosses.
+  int level = 0;
+  float size = cellSize;
+  int cx, cy, ex, ey;
+  for (;; level++, size *= levelScale) {
+    cx = cellCoord(edge->x1, size);
+    cy = cellCoord(edge->y1, size);
+    ex = cellCoord(edge->x2, size);
+    ey = cellCoord(edge->y2, size);
+    if (level == edgeLevels - 1 ||
+        std::abs(ex - cx) + std::abs(ey - cy) < maxEdgeCells)
+      break;
+  }
+  edge->level = level;
+
+  float dx = edge->x2 - edge->x1;
+  float dy = edge->y2 - edge->y1;
+  int stepX = dx > 0 ? 1 : -1;
+  int stepY = dy > 0 ? 1 : -1;
+
+  // Walk the cells the segment crosses, always stepping towards the end cell
+  // so rounding can never overshoot it.
+  float tMaxX = dx != 0 ? ((cx + (stepX > 0)) * size - edge->x1) / dx : 0;
+  float tMaxY = dy != 0 ? ((cy + (stepY > 0)) * size - edge->y1) / dy : 0;
+  float tDeltaX = dx != 0 ? size / std::fabs(dx) : 0;
+  float tDeltaY = dy != 0 ? size / std::fabs(dy) : 0;
+
+  edge->cells.clear();
+  edge->cells.push_back(cellKey(cx, cy));
+  while (cx != ex || cy != ey) {
+    if (cy == ey || (cx != ex && tMaxX < tMaxY)) {
+      cx += stepX;
+      tMaxX += tDeltaX;
+    } else {
+      cy += stepY;
+      tMaxY += tDeltaY;
+    }
+    edge->cells.push_back(cellKey(cx, cy));
+  }
+
+  auto &buckets = this->edgeCells[level];
+  for (uint64_t cell : edge->cells)
+    buckets[cell].push_back(edge);
+}
+
+void SpatialIndex::unlinkEdge(Edge *edge) {
+  auto &buckets = this->edgeCells[edge->level];
+  for (uint64_t cell : edge->cells) {
+    auto it = buckets.find(cell);
+    if (it == buckets.end())
+      continue;
+
+    std::vector<Edge *> &bucket = it->second;
+    for (size_t i = 0; i < bucket.size(); i++) {
+      if (bucket[i] == edge) {
+        bucket[i] = bucket.back();
+        bucket.pop_back();
+        break;
+      }
+    }
+
+    if (bucket.empty())
+      buckets.erase(it);
+  }
+  edge->cells.clear();
+}
+
+void SpatialIndex::updateEdge(Node *from, Node *to, float x1, float y1,
+                              float x2, float y2) {
+  Edge &edge = this->edges[{from, to}];
+  if (!edge.cells.empty()) {
+    if (edge.x1 == x1 && edge.y1 == y1 && edge.x2 == x2 && edge.y2 == y2)
+      return;
+    this->unlinkEdge(&edge);
+  }
+
+  edge.from = from;
+  edge.to = to;
+  edge.x1 = x1;
+  edge.y1 = y1;
+  edge.x2 = x2;
+  edge.y2 = y2;
+  this->linkEdge(&edge);
+}
+
+void SpatialIndex::removeEdge(Node *from, Node *to) {
+  auto it = this->edges.find({from, to});
+  if (it == this->edges.end())
+    return;
+
+  this->unlinkEdge(&it->second);
+  this->edges.erase(it);
+}
+
+void SpatialIndex::clear() {
+  this->cells.clear();
+  this->entries.clear();
+  for (auto &buckets : this->edgeCells)
+    buckets.clear();
+  this->edges.clear();
+  this->maxRadius = 0;
+}
+
+Node *SpatialIndex::queryPoint(float x, float y) const {
+  int cx1 = cellCoord(x - this->maxRadius);
+  int cy1 = cellCoord(y - this->maxRadius);
+  int cx2 = cellCoord(x + this->maxRadius);
+  int cy2 = cellCoord(y + this->maxRadius);
+
+  Node *best = nullptr;
+  float bestDist = 0;
+
+  for (int cx = cx1; cx <= cx2; cx++) {
+    for (int cy = cy1; cy <= cy2; cy++) {
+      auto it = this->cells.find(cellKey(cx, cy));
+      if (it == this->cells.end())
+        continue;
+
+      for (const Item &item : it->second) {
+        float dx = item.x - x;
+        float dy = item.y - y;
+        float d = dx * dx + dy * dy;
+        if (d < item.radius * item.radius && (!best || d < bestDist)) {
+          best = item.node;
+          bestDist = d;
+        }
+      }
+    }
+  }
+
+  return best;
+}
+
+void SpatialIndex::queryRect(float x1, float y1, float x2, float y2,
+                             std::vector<Node *> &out) const {
+  int cx1 = cellCoord(x1 - this->maxRadius);
+  int cy1 = cellCoord(y1 - this->maxRadius);
+  int cx2 = cellCoord(x2 + this->maxRadius);
+  int cy2 = cellCoord(y2 + this->maxRadius);
+
+  auto test = [&](const Item &item) {
+    float nx = std::clamp(item.x, x1, x2);
+    float ny = std::clamp(item.y, y1, y2);
+    float dx = item.x - nx;
+    float dy = item.y - ny;
+    if (dx * dx + dy * dy <= item.radius * item.radius)
+      out.push_back(item.node);
+  };
+
+  // Sparse maps viewed from far out cover more cells than there are buckets.
+  if (static_cast<int64_t>(cx2 - cx1 + 1) * (cy2 - cy1 + 1) >
+      static_cast<int64_t>(this->cells.size())) {
+    for (const auto &[cell, bucket] : this->cells)
+      for (const Item &item : bucket)
+        test(item);
+    return;
+  }
+
+  for (int cx = cx1; cx <= cx2; cx++) {
+    for (int cy = cy1; cy <= cy2; cy++) {
+      auto it = this->cells.find(cellKey(cx, cy));
+      if (it == this->cells.end())
+        continue;
+
+      for (const Item &item : it->second)
+        test(item);
+    }
+  }
+}
+
+bool SpatialIndex::crossesRect(const Edge &edge, float x1, float y1, float x2,
+                               float y2) {
+  // Liang-Barsky: true if any part of the segment lies in the rect.
+  float dx = edge.x2 - edge.x1;
+  float dy = edge.y2 - edge.y1;
+  float p[4] = {-dx, dx, -dy, dy};
+  float q[4] = {edge.x1 - x1, x2 - edge.x1, edge.y1 - y1, y2 - edge.y1};
+  float t0 = 0;
+  float t1 = 1;
+
+  for (int i = 0; i < 4; i++) {
+    if (p[i] == 0) {
+      if (q[i] < 0)
+        return false;
+      continue;
+    }
+
+    float t = q[i] / p[i];
+    if (p[i] < 0) {
+      if (t > t1)
+        return false;
+      if (t > t0)
+        t0 = t;
+    } else {
+      if (t < t0)
+        return false;
+      if (t < t1)
+        t1 = t;
+    }
+  }
+  return true;
+}
+
+// Calls f for every edge stored in a cell the rect touches, on each level,
+// once per cell.
+template <class F>
+void SpatialIndex::forEachEdgeNear(float x1, float y1, float x2, float y2,
+                                   F f) const {
+  auto cellsCovered = [&](float size) {
+    return static_cast<int64_t>(cellCoord(x2, size) - cellCoord(x1, size) + 1) *
+           (cellCoord(y2, size) - cellCoord(y1, size) + 1);
+  };
+
+  if (cellsCovered(cellSize) > static_cast<int64_t>(this->edges.size())) {
+    for (const auto &[key, edge] : this->edges)
+      f(&edge);
+    return;
+  }
+
+  float size = cellSize;
+  for (int level = 0; level < edgeLevels; level++, size *= levelScale) {
+    const auto &buckets = this->edgeCells[level];
+
+    if (cellsCovered(size) > static_cast<int64_t>(buckets.size())) {
+      for (const auto &[cell, bucket] : buckets)
+        for (const Edge *edge : bucket)
+          f(edge);
+      continue;
+    }
+
+    int cx1 = cellCoord(x1, size);
+    int cy1 = cellCoord(y1, size);
+    int cx2 = cellCoord(x2, size);
+    int cy2 = cellCoord(y2, size);
+    for (int cx = cx1; cx <= cx2; cx++) {
+      for (int cy = cy1; cy <= cy2; cy++) {
+        auto it = buckets.find(cellKey(cx, cy));
+        if (it == buckets.end())
+          continue;
+
+        for (const Edge *edge : it->second)
+          f(edge);
+      }
+    }
+  }
+}
+
+void SpatialIndex::queryEdges(
+    float x1, float y1, float x2, float y2,
+    std::vector<std::pair<Node *, Node *>> &out) const {
+  uint32_t stamp = ++this->edgeStamp;
+
+  this->forEachEdgeNear(x1, y1, x2, y2, [&](const Edge *edge) {
+    if (edge->stamp == stamp)
+      return;
+    edge->stamp = stamp;
+
+    if (crossesRect(*edge, x1, y1, x2, y2))
+      out.push_back({edge->from, edge->to});
+  });
+}
+
+void SpatialIndex::queryEdgesShared(
+    float x1, float y1, float x2, float y2,
+    std::vector<std::pair<Node *, Node *>> &out) const {
+  size_t first = out.size();
+  this->forEachEdgeNear(x1, y1, x2, y2, [&](const Edge *edge) {
+    if (crossesRect(*edge, x1, y1, x2, y2))
+      out.push_back({edge->from, edge->to});
+  });
+
+  std::sort(out.begin() + first, out.end());
+  out.erase(std::unique(out.begin() + first, out.end()), out.end());
+}
+
+size_t SpatialIndex::size() const { return this->entries.size(); }
@@ -0,0 +1,102 @@
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class Node;
+
+// Loose uniform grid over node centres. Each node lives in the cell holding
+// its centre; queries widen their search by the largest radius seen so far.
+// Edges are stored separately in every cell their segment passes through,
+// on a stack of grids each levelScale times coarser than the last: an edge
+// goes on the finest level where it crosses fewer than maxEdgeCells cells,
+// so a long edge costs a few coarse cells rather than thousands of fine ones
+// and queries still only look near the rect.
+class SpatialIndex {
+public:
+  void insert(Node *node, float x, float y, float radius);
+  void update(Node *node, float x, float y, float radius);
+  void remove(Node *node);
+
+  void updateEdge(Node *from, Node *to, float x1, float y1, float x2,
+                  float y2);
+  void removeEdge(Node *from, Node *to);
+
+  void clear();
+
+  Node *queryPoint(float x, float y) const;
+  void queryRect(float x1, float y1, float x2, float y2,
+                 std::vector<Node *> &out) const;
+  void queryEdges(float x1, float y1, float x2, float y2,
+                  std::vector<std::pair<Node *, Node *>> &out) const;
+  // Like queryEdges, but leaves the visit stamps alone so several threads
+  // can query at once; duplicates are sorted out of out instead.
+  void queryEdgesShared(float x1, float y1, float x2, float y2,
+                        std::vector<std::pair<Node *, Node *>> &out) const;
+
+  size_t size() const;
+
+private:
+  struct Item {
+    Node *node;
+    float x;
+    float y;
+    float radius;
+  };
+
+  struct EdgeKeyHash {
+    size_t operator()(const std::pair<Node *, Node *> &key) const {
+      size_t a = std::hash<Node *>()(key.first);
+      size_t b = std::hash<Node *>()(key.second);
+      return a ^ (b + 0x9e3779b97f4a7c15ULL + (a << 6) + (a >> 2));
+    }
+  };
+
+  struct Edge {
+    Node *from;
+    Node *to;
+    float x1;
+    float y1;
+    float x2;
+    float y2;
+    std::vector<uint64_t> cells;
+    // Grid level the cells are on.
+    int level = 0;
+    mutable uint32_t stamp = 0;
+  };
+
+  static constexpr float cellSize = 512;
+  static constexpr int edgeLevels = 5;
+  static constexpr int levelScale = 8;
+  static constexpr int maxEdgeCells = 64;
+
+  static int cellCoord(float v, float size = cellSize);
+  static uint64_t cellKey(int cx, int cy);
+
+  Item *findInCell(Node *node, uint64_t cell);
+  void removeFromCell(Node *node, uint64_t cell);
+
+  static bool crossesRect(const Edge &edge, float x1, float y1, float x2,
+                          float y2);
+  template <class F>
+  void forEachEdgeNear(float x1, float y1, float x2, float y2, F f) const;
+
+  void unlinkEdge(Edge *edge);
+  void linkEdge(Edge *edge);
+
+  std::unordered_map<uint64_t, std::vector<Item>> cells;
+  std::unordered_map<Node *, uint64_t> entries;
+
+  std::unordered_map<uint64_t, std::vector<Edge *>> edgeCells[edgeLevels];
+  std::unordered_map<std::pair<Node *, Node *>, Edge, EdgeKeyHash> edges;
+  mutable uint32_t edgeStamp = 0;
+
+  float maxRadius = 0;
+};
+
+#endif
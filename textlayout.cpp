@@ -0,0 +1,218 @@
+#include "textlayout.h"
+#include <algorithm>
+#include <cmath>
+
+// Wrap widths are snapped to this step so most keystrokes keep the current
+// width and only re-break the edited line.
+static constexpr int wrapStep = 8;
+
+Uint32 decodeUtf8(const std::string &text, size_t &i) {
+  unsigned char c = text[i++];
+  if (c < 0x80)
+    return c;
+
+  int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+  Uint32 cp = c & (0x3F >> extra);
+
+  for (int k = 0; k < extra && i < text.size(); k++) {
+    unsigned char cc = text[i];
+    if ((cc & 0xC0) != 0x80)
+      break;
+    cp = (cp << 6) | (cc & 0x3F);
+    i++;
+  }
+
+  return cp;
+}
+
+FontMetrics *FontMetrics::get(TTF_Font *font) {
+  auto &entry = metrics[font];
+  if (!entry)
+    entry.reset(new FontMetrics(font));
+  return entry.get();
+}
+
+FontMetrics::FontMetrics(TTF_Font *font)
+    : font(font), lineHeight(TTF_FontHeight(font)) {
+  std::fill(std::begin(this->ascii), std::end(this->ascii), -1);
+}
+
+int FontMetrics::advance(Uint32 codepoint) {
+  int *slot;
+  if (codepoint < 128) {
+    slot = &this->ascii[codepoint];
+    if (*slot >= 0)
+      return *slot;
+  } else {
+    auto it = this->extended.find(codepoint);
+    if (it != this->extended.end())
+      return it->second;
+    slot = &this->extended[codepoint];
+  }
+
+  int minx, maxx, miny, maxy, adv;
+  if (TTF_GlyphMetrics32(this->font, codepoint, &minx, &maxx, &miny, &maxy,
+                         &adv) != 0)
+    adv = 0;
+
+  *slot = adv;
+  return adv;
+}
+
+int FontMetrics::kerning(Uint32 left, Uint32 right) {
+  uint64_t key = (static_cast<uint64_t>(left) << 32) | right;
+  auto it = this->kerningPairs.find(key);
+  if (it != this->kerningPairs.end())
+    return it->second;
+
+  int k = TTF_GetFontKerningSizeGlyphs32(this->font, left, right);
+  this->kerningPairs[key] = k;
+  return k;
+}
+
+int FontMetrics::measure(const std::string &text, size_t begin, size_t end) {
+  int w = 0;
+  Uint32 prev = 0;
+
+  size_t i = begin;
+  while (i < end) {
+    Uint32 cp = decodeUtf8(text, i);
+    if (prev)
+      w += this->kerning(prev, cp);
+    w += this->advance(cp);
+    prev = cp;
+  }
+
+  return w;
+}
+
+int FontMetrics::getLineHeight() const { return this->lineHeight; }
+
+int TextLayout::wrapWidthFor(int totalAdvance, int lineHeight) {
+  int len = static_cast<int>(std::sqrt(static_cast<double>(totalAdvance) *
+                                       lineHeight));
+  return len / wrapStep * wrapStep;
+}
+
+void TextLayout::reset(FontMetrics *metrics, const std::string &text) {
+  this->totalAdvance = 0;
+  size_t i = 0;
+  while (i < text.size())
+    this->totalAdvance += metrics->advance(decodeUtf8(text, i));
+
+  this->wrapWidth = wrapWidthFor(this->totalAdvance, metrics->getLineHeight());
+  this->lines.clear();
+  this->breakFrom(metrics, text, 0, {}, 0);
+}
+
+void TextLayout::insert(FontMetrics *metrics, const std::string &text,
+                        size_t pos, size_t count) {
+  int delta = 0;
+  size_t i = pos;
+  while (i < pos + count)
+    delta += metrics->advance(decodeUtf8(text, i));
+
+  this->relayout(metrics, text, pos, 0, count, delta);
+}
+
+void TextLayout::erase(FontMetrics *metrics, const std::string &text,
+                       size_t pos, const std::string &removed) {
+  int delta = 0;
+  size_t i = 0;
+  while (i < removed.size())
+    delta -= metrics->advance(decodeUtf8(removed, i));
+
+  this->relayout(metrics, text, pos, removed.size(), 0, delta);
+}
+
+void TextLayout::relayout(FontMetrics *metrics, const std::string &text,
+                          size_t pos, size_t removed, size_t inserted,
+                          int advanceDelta) {
+  this->totalAdvance += advanceDelta;
+
+  int wrap = wrapWidthFor(this->totalAdvance, metrics->getLineHeight());
+  if (wrap != this->wrapWidth || this->lines.empty()) {
+    this->reset(metrics, text);
+    return;
+  }
+
+  // The line holding the edit point is the first one whose breaks can move;
+  // everything before it was decided by text the edit did not touch.
+  size_t lineIndex = 0;
+  while (lineIndex + 1 < this->lines.size() &&
+         this->lines[lineIndex + 1].begin <= pos)
+    lineIndex++;
+
+  size_t lineBegin = this->lines[lineIndex].begin;
+
+  std::vector<Line> tail;
+  long shift = static_cast<long>(inserted) - static_cast<long>(removed);
+  for (size_t i = lineIndex + 1; i < this->lines.size(); i++) {
+    Line line = this->lines[i];
+    if (line.begin < pos + removed)
+      continue;
+    line.begin += shift;
+    line.end += shift;
+    tail.push_back(line);
+  }
+
+  this->lines.resize(lineIndex);
+  this->breakFrom(metrics, text, lineBegin, std::move(tail), pos + inserted);
+}
+
+void TextLayout::breakFrom(FontMetrics *metrics, const std::string &text,
+                           size_t lineBegin, std::vector<Line> tail,
+                           size_t editEnd) {
+  size_t nextTail = 0;
+  int width = 0;
+
+  size_t i = lineBegin;
+  while (i < text.size()) {
+    size_t at = i;
+    Uint32 cp = decodeUtf8(text, i);
+
+    if (cp == '\n' || (cp == ' ' && width > this->wrapWidth)) {
+      this->lines.push_back(
+          {lineBegin, at, metrics->measure(text, lineBegin, at)});
+      lineBegin = i;
+      width = 0;
+
+      // Past the edit, a break that matches the old layout means every
+      // later line is unchanged apart from its offset.
+      if (lineBegin >= editEnd) {
+        while (nextTail < tail.size() && tail[nextTail].begin < lineBegin)
+          nextTail++;
+        if (nextTail < tail.size() && tail[nextTail].begin == lineBegin) {
+          this->lines.insert(this->lines.end(), tail.begin() + nextTail,
+                             tail.end());
+          this->updateExtent(metrics);
+          return;
+        }
+      }
+      continue;
+    }
+
+    width += metrics->advance(cp);
+  }
+
+  if (lineBegin < text.size())
+    this->lines.push_back(
+        {lineBegin, text.size(), metrics->measure(text, lineBegin, text.size())});
+
+  this->updateExtent(metrics);
+}
+
+void TextLayout::updateExtent(FontMetrics *metrics) {
+  this->width = 0;
+  for (const Line &line : this->lines)
+    this->width = std::max(this->width, line.width);
+  this->height = static_cast<int>(this->lines.size()) *
+                 metrics->getLineHeight();
+}
+
+const std::vector<TextLayout::Line> &TextLayout::getLines() const {
+  return this->lines;
+}
+
+int TextLayout::getWidth() const { return this->width; }
+int TextLayout::getHeight() const { return this->height; }
@@ -0,0 +1,80 @@
+#ifndef TEXTLAYOUT_H
+#define TEXTLAYOUT_H
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+Uint32 decodeUtf8(const std::string &text, size_t &i);
+
+// Per-font cache of glyph advances and kerning pairs, filled on first use.
+class FontMetrics {
+public:
+  static FontMetrics *get(TTF_Font *font);
+
+  int advance(Uint32 codepoint);
+  int kerning(Uint32 left, Uint32 right);
+  int measure(const std::string &text, size_t begin, size_t end);
+
+  int getLineHeight() const;
+
+private:
+  explicit FontMetrics(TTF_Font *font);
+
+  inline static std::map<TTF_Font *, std::unique_ptr<FontMetrics>> metrics;
+
+  TTF_Font *font;
+  int lineHeight;
+
+  int ascii[128];
+  std::unordered_map<Uint32, int> extended;
+  std::unordered_map<uint64_t, int> kerningPairs;
+};
+
+// Word wrap for node labels. Lines break at the first space after the
+// running width passes the wrap width, which is derived from the label's
+// total advance so labels stay roughly square. Edits re-break from the line
+// holding the edit point and stop as soon as a break lines up with the old
+// layout again.
+class TextLayout {
+public:
+  struct Line {
+    size_t begin;
+    size_t end;
+    int width;
+  };
+
+  void reset(FontMetrics *metrics, const std::string &text);
+  void insert(FontMetrics *metrics, const std::string &text, size_t pos,
+              size_t count);
+  void erase(FontMetrics *metrics, const std::string &text, size_t pos,
+             const std::string &removed);
+
+  const std::vector<Line> &getLines() const;
+  int getWidth() const;
+  int getHeight() const;
+
+private:
+  void relayout(FontMetrics *metrics, const std::string &text, size_t pos,
+                size_t removed, size_t inserted, int advanceDelta);
+  void breakFrom(FontMetrics *metrics, const std::string &text,
+                 size_t lineBegin, std::vector<Line> tail, size_t editEnd);
+  void updateExtent(FontMetrics *metrics);
+
+  static int wrapWidthFor(int totalAdvance, int lineHeight);
+
+  std::vector<Line> lines;
+
+  int totalAdvance = 0;
+  int wrapWidth = 0;
+
+  int width = 0;
+  int height = 0;
+};
+
+#endif
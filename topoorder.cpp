@@ -0,0 +1,148 @@
+#include "topoorder.h"
+#include "nodestore.h"
+#include <algorithm>
+
+TopoOrder::TopoOrder(const NodeStore &nodes) : nodes(nodes) {}
+
+void TopoOrder::insert(uint32_t index) {
+  if (index >= this->rank.size()) {
+    this->rank.resize(index + 1, 0);
+    this->mark.resize(index + 1, 0);
+  }
+
+  this->rank[index] = this->nextRank++;
+}
+
+void TopoOrder::clear() {
+  this->rank.clear();
+  this->mark.clear();
+  this->stamp = 0;
+  this->nextRank = 0;
+}
+
+bool TopoOrder::rebuild() {
+  // `mark` doubles as the remaining in-degree of each node here.
+  this->stack.clear();
+  this->nodes.forEach([this](Node *node) {
+    uint32_t index = node->getId().index;
+    if (index >= this->rank.size()) {
+      this->rank.resize(index + 1, 0);
+      this->mark.resize(index + 1, 0);
+    }
+    this->mark[index] = static_cast<uint32_t>(node->getParents().size());
+    if (node->getParents().empty())
+      this->stack.push_back(index);
+  });
+
+  this->nextRank = 0;
+  while (!this->stack.empty()) {
+    uint32_t index = this->stack.back();
+    this->stack.pop_back();
+    this->rank[index] = this->nextRank++;
+
+    for (uint32_t child : this->nodes.at(index)->getChildren())
+      if (--this->mark[child] == 0)
+        this->stack.push_back(child);
+  }
+
+  std::fill(this->mark.begin(), this->mark.end(), 0);
+  this->stamp = 0;
+
+  return this->nextRank == static_cast<int>(this->nodes.size());
+}
+
+int TopoOrder::getRank(uint32_t index) const { return this->rank[index]; }
+
+void TopoOrder::sortByRank(std::vector<uint32_t> &list) const {
+  std::sort(list.begin(), list.end(), [this](uint32_t a, uint32_t b) {
+    return this->rank[a] < this->rank[b];
+  });
+}
+
+bool TopoOrder::addEdge(uint32_t from, uint32_t to) {
+  if (from == to)
+    return false;
+
+  int lower = this->rank[to];
+  int upper = this->rank[from];
+  if (upper < lower)
+    return true;
+
+  // Forward search from `to` through nodes ranked no later than `from`.
+  // Reaching `from` means the new edge would close a cycle.
+  this->forward.clear();
+  this->stack.assign(1, to);
+  this->mark[to] = ++this->stamp;
+  while (!this->stack.empty()) {
+    uint32_t index = this->stack.back();
+    this->stack.pop_back();
+    this->forward.push_back(index);
+
+    for (uint32_t child : this->nodes.at(index)->getChildren()) {
+      if (child == from)
+        return false;
+      if (this->mark[child] != this->stamp && this->rank[child] < upper) {
+        this->mark[child] = this->stamp;
+        this->stack.push_back(child);
+      }
+    }
+  }
+
+  // Backward search from `from` through nodes ranked after `to`.
+  this->backward.clear();
+  this->stack.assign(1, from);
+  this->mark[from] = ++this->stamp;
+  while (!this->stack.empty()) {
+    uint32_t index = this->stack.back();
+    this->stack.pop_back();
+    this->backward.push_back(index);
+
+    for (uint32_t parent : this->nodes.at(index)->getParents()) {
+      if (this->mark[parent] != this->stamp && this->rank[parent] > lower) {
+        this->mark[parent] = this->stamp;
+        this->stack.push_back(parent);
+      }
+    }
+  }
+
+  // Hand the affected ranks back out with every ancestor of `from` ahead of
+  // every descendant of `to`, each group keeping its relative order.
+  this->sortByRank(this->backward);
+  this->sortByRank(this->forward);
+
+  this->ranks.clear();
+  for (uint32_t index : this->backward)
+    this->ranks.push_back(this->rank[index]);
+  for (uint32_t index : this->forward)
+    this->ranks.push_back(this->rank[index]);
+  std::sort(this->ranks.begin(), this->ranks.end());
+
+  size_t i = 0;
+  for (uint32_t index : this->backward)
+    this->rank[index] = this->ranks[i++];
+  for (uint32_t index : this->forward)
+    this->rank[index] = this->ranks[i++];
+
+  return true;
+}
+
+const std::vector<uint32_t> &TopoOrder::descendants(uint32_t index) {
+  this->forward.clear();
+  this->stack.assign(1, index);
+  this->mark[index] = ++this->stamp;
+  while (!this->stack.empty()) {
+    uint32_t current = this->stack.back();
+    this->stack.pop_back();
+    this->forward.push_back(current);
+
+    for (uint32_t child : this->nodes.at(current)->getChildren()) {
+      if (this->mark[child] != this->stamp) {
+        this->mark[child] = this->stamp;
+        this->stack.push_back(child);
+      }
+    }
+  }
+
+  this->sortByRank(this->forward);
+  return this->forward;
+}
@@ -0,0 +1,47 @@
+#ifndef TOPOORDER_H
+#define TOPOORDER_H
+
+#include <cstdint>
+#include <vector>
+
+class NodeStore;
+
+// Incremental topological order over the node DAG (Pearce & Kelly, 2006).
+// Every live node has a distinct rank with parents ranked before children.
+// Adding an edge that already agrees with the ranks is O(1); otherwise only
+// the nodes between the two endpoints' ranks are searched and reshuffled,
+// and an edge that would close a cycle is refused.
+class TopoOrder {
+public:
+  explicit TopoOrder(const NodeStore &nodes);
+
+  void insert(uint32_t index);
+  bool addEdge(uint32_t from, uint32_t to);
+  void clear();
+
+  // Re-ranks every live node from scratch (Kahn's algorithm) after edges
+  // were linked in bulk. Returns false if the edges contain a cycle.
+  bool rebuild();
+
+  int getRank(uint32_t index) const;
+
+  // The node and everything reachable from it, each once, in rank order.
+  const std::vector<uint32_t> &descendants(uint32_t index);
+
+private:
+  void sortByRank(std::vector<uint32_t> &list) const;
+
+  const NodeStore &nodes;
+
+  std::vector<int> rank;
+  std::vector<uint32_t> mark;
+  uint32_t stamp = 0;
+  int nextRank = 0;
+
+  std::vector<uint32_t> stack;
+  std::vector<uint32_t> forward;
+  std::vector<uint32_t> backward;
+  std::vector<int> ranks;
+};
+
+#endif